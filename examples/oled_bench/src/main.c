@@ -0,0 +1,126 @@
+/***********************************************************************
+ * 
+ * Benchmark of full-screen fill of the OLED frame buffer. Cycles of
+ * the byte-granular oled_fillRect() are compared with the previous
+ * algorithm, which drew every row by oled_drawLine() pixel by pixel.
+ * Results are sent to UART at 115200 Bd.
+ * (c) 2025 Tomas Fryza, MIT license
+ * 
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+// -- Includes -------------------------------------------------------
+#include <avr/io.h>         // AVR device-specific IO definitions
+#include <avr/interrupt.h>  // Interrupts standard C library for AVR-GCC
+#include <avr/pgmspace.h>   // Strings in program memory
+#include <util/atomic.h>    // Atomic sections
+#include <stdlib.h>         // C library. Needed for abs()
+#include "timer.h"          // Timer library for AVR-GCC
+#include <uart.h>           // Peter Fleury's UART library
+#include <oled.h>           // OLED display library
+
+
+// -- Global variables -----------------------------------------------
+volatile uint16_t tim1_overflows = 0;
+
+
+// -- Function definitions -------------------------------------------
+/*
+ * Function: cycles()
+ * Purpose:  Read CPU cycles counted by Timer/Counter1 with prescaler 1.
+ * Returns:  Number of cycles since timer start
+ */
+uint32_t cycles(void)
+{
+    uint16_t ovf, cnt;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        cnt = TCNT1;
+        ovf = tim1_overflows;
+        // Overflow not served yet
+        if ((TIFR1 & (1<<TOV1)) && cnt < 0x8000)
+            ovf++;
+    }
+    return ((uint32_t)ovf << 16) | cnt;
+}
+
+
+/*
+ * Function: old_fillRect()
+ * Purpose:  Previous oled_fillRect(), one Bresenham line per row and
+ *           one oled_drawPixel() per pixel.
+ */
+void old_fillRect(uint8_t px1, uint8_t py1, uint8_t px2, uint8_t py2, uint8_t color)
+{
+    for (uint8_t i = 0; i <= (py2-py1); i++) {
+        uint8_t x1 = px1, y1 = py1+i;
+        int dx =  abs(px2-x1), sx = x1<px2 ? 1 : -1;
+        int dy = 0, sy = 1;
+        int err = dx+dy, e2;
+
+        while (1) {
+            oled_drawPixel(x1, y1, color);
+            if (x1 == px2)
+                break;
+            e2 = 2*err;
+            if (e2 > dy) { err += dy; x1 += sx; }
+            if (e2 < dx) { err += dx; y1 += sy; }
+        }
+    }
+}
+
+
+/*
+ * Function: Main function where the program execution begins
+ * Purpose:  Fill and clear the whole buffer by both algorithms, print
+ *           cycles of each run, and show the last frame.
+ * Returns:  none
+ */
+int main(void)
+{
+    uint32_t start, old_cycles, new_cycles;
+
+    uart_init(UART_BAUD_SELECT(115200, F_CPU));
+    oled_init(OLED_DISP_ON);
+
+    // Timer/Counter1 counts CPU cycles, overflow every 4 ms
+    tim1_ovf_4ms();
+    tim1_ovf_enable();
+    sei();
+
+    uart_puts_P("\r\nFull-screen fill, 128x64 pixels\r\n");
+
+    // Infinite loop
+    while (1) {
+        oled_clear_buffer();
+        start = cycles();
+        old_fillRect(0, 0, 127, 63, WHITE);
+        old_cycles = cycles() - start;
+
+        oled_clear_buffer();
+        start = cycles();
+        oled_fillRect(0, 0, 127, 63, WHITE);
+        new_cycles = cycles() - start;
+
+        oled_display();
+        uart_printf_P(PSTR("drawLine per row: %lu cycles, fillRect: %lu cycles\r\n"),
+                      old_cycles, new_cycles);
+        oled_clear_buffer();
+        oled_display();
+    }
+
+    // Will never reach this
+    return 0;
+}
+
+
+// -- Interrupt service routines -------------------------------------
+/*
+ * Function: Timer/Counter1 overflow interrupt
+ * Purpose:  Extend Timer/Counter1 to 32 bits.
+ */
+ISR(TIMER1_OVF_vect)
+{
+    tim1_overflows++;
+}
@@ -51,6 +51,10 @@
 #if defined SPI
 # include <util/delay.h>
 #endif
+#if defined GRAPHICMODE
+# include <avr/interrupt.h>
+# include <util/atomic.h>
+#endif
 
 static struct {
     uint8_t x;
@@ -61,6 +65,29 @@ static uint8_t charMode = NORMALSIZE;
 #if defined GRAPHICMODE
 # include <stdlib.h>
 static uint8_t displayBuffer[DISPLAY_HEIGHT/8][DISPLAY_WIDTH];
+static struct {
+    uint8_t first;
+    uint8_t last;
+} dirtyRegion[DISPLAY_HEIGHT/8];  // changed columns per page, first > last if clean
+static uint32_t dirtyBytes;  // data bytes sent by oled_display()
+
+// background transfer of oled_display_async()
+static struct {
+    uint8_t first;
+    uint8_t last;
+} sendRegion[DISPLAY_HEIGHT/8];  // columns to be sent, kept if sending has failed
+static volatile uint8_t sendPage = DISPLAY_HEIGHT/8;  // page being sent, DISPLAY_HEIGHT/8 if idle
+static void (*sendCallback)(void);
+# if defined I2C
+static uint8_t sendHeader[15];  // control byte with Co bit before each command, then 0x40
+static twi_xfer_t sendXfer;
+static void oled_send_done(twi_xfer_t *x);
+# elif defined SPI
+static uint8_t sendCommand[7];
+static uint8_t sendCommandLength;
+static uint8_t sendLength;  // commands and data bytes
+static volatile uint8_t sendIndex;
+# endif
 #elif defined TEXTMODE
 #else
 # error "No valid displaymode! Refer oled.h"
@@ -111,6 +138,9 @@ void oled_command(uint8_t cmd[], uint8_t size) {
     }
     twi_stop();
 #elif defined SPI
+#if defined GRAPHICMODE
+	while (oled_busy());
+#endif
 	OLED_PORT &= ~(1 << CS_PIN);
 	OLED_PORT &= ~(1 << DC_PIN);
 	for (uint8_t i=0; i<size; i++) {
@@ -134,6 +164,9 @@ void oled_data(uint8_t data[], uint16_t size) {
     twi_stop();
     // i2c_stop();
 #elif defined SPI
+#if defined GRAPHICMODE
+	while (oled_busy());
+#endif
 	OLED_PORT &= ~(1 << CS_PIN);
 	OLED_PORT |= (1 << DC_PIN);
 	for (uint16_t i = 0; i<size; i++) {
@@ -165,29 +198,53 @@ void oled_init(uint8_t dispAttr){
     }
     commandSequence[sizeof(init_sequence)]=(dispAttr);
     oled_command(commandSequence, sizeof(commandSequence));
+#if defined GRAPHICMODE && defined I2C
+    sendXfer.addr = OLED_I2C_ADR;
+    sendXfer.wbuf = sendHeader;
+    sendXfer.clock = twi_clock_div(OLED_I2C_HZ);
+    sendXfer.callback = oled_send_done;
+#endif
     oled_clrscr();
 }
 void oled_gotoxy(uint8_t x, uint8_t y){
     x = x * sizeof(FONT[0]);
     oled_goto_xpix_y(x,y);
 }
+static uint8_t oled_address_sequence(uint8_t x, uint8_t y, uint8_t commandSequence[]){
+#if defined (SSD1306) || defined (SSD1309)
+    // page range is needed at horizontal addressing mode
+    const uint8_t sequence[] = {0xb0+y, 0x21, x, 0x7f, 0x22, y, DISPLAY_HEIGHT/8-1};
+#elif defined SH1106
+    const uint8_t sequence[] = {0xb0+y, 0x21, 0x00+((2+x) & (0x0f)), 0x10+( ((2+x) & (0xf0)) >> 4 ), 0x7f};
+#endif
+    memcpy(commandSequence, sequence, sizeof(sequence));
+    return sizeof(sequence);
+}
+static void oled_set_address(uint8_t x, uint8_t y){
+    uint8_t commandSequence[7];
+    oled_command(commandSequence, oled_address_sequence(x, y, commandSequence));
+}
 void oled_goto_xpix_y(uint8_t x, uint8_t y){
     if( x > (DISPLAY_WIDTH) || y > (DISPLAY_HEIGHT/8-1)) return;// out of display
     cursorPosition.x=x;
     cursorPosition.y=y;
-#if defined (SSD1306) || defined (SSD1309)
-    uint8_t commandSequence[] = {0xb0+y, 0x21, x, 0x7f};
-#elif defined SH1106
-    uint8_t commandSequence[] = {0xb0+y, 0x21, 0x00+((2+x) & (0x0f)), 0x10+( ((2+x) & (0xf0)) >> 4 ), 0x7f};
+#if defined TEXTMODE
+    // at GRAPHICMODE the address is set by oled_display()
+    oled_set_address(x, y);
 #endif
-    oled_command(commandSequence, sizeof(commandSequence));
 }
 void oled_clrscr(void){
 #ifdef GRAPHICMODE
+    // send regions are used by the running oled_display_async()
+    while (oled_busy());
     for (uint8_t i = 0; i < DISPLAY_HEIGHT/8; i++){
         memset(displayBuffer[i], 0x00, sizeof(displayBuffer[i]));
-        oled_gotoxy(0,i);
+        oled_set_address(0,i);
         oled_data(displayBuffer[i], sizeof(displayBuffer[i]));
+        dirtyRegion[i].first = 0xff;
+        dirtyRegion[i].last = 0;
+        sendRegion[i].first = 0xff;
+        sendRegion[i].last = 0;
     }
 #elif defined TEXTMODE
     uint8_t displayBuffer[DISPLAY_WIDTH];
@@ -224,6 +281,76 @@ void oled_set_contrast(uint8_t contrast){
     uint8_t commandSequence[2] = {0x81, contrast};
     oled_command(commandSequence, sizeof(commandSequence));
 }
+#ifdef GRAPHICMODE
+static void oled_set_dirty(uint8_t x1, uint8_t x2, uint8_t page){
+    if (x1 < dirtyRegion[page].first) dirtyRegion[page].first = x1;
+    if (x2 > dirtyRegion[page].last) dirtyRegion[page].last = x2;
+}
+static void oled_write_buffer(uint8_t x, uint8_t page, uint8_t data){
+    if (displayBuffer[page][x] != data) {
+        displayBuffer[page][x] = data;
+        oled_set_dirty(x, x, page);
+    }
+}
+#endif
+// column of font scaled by 2, 3 or 4, doubled nibble by nibble
+static const uint8_t scale2[16] PROGMEM = {
+    0x00, 0x03, 0x0c, 0x0f, 0x30, 0x33, 0x3c, 0x3f, 0xc0, 0xc3, 0xcc, 0xcf, 0xf0, 0xf3, 0xfc, 0xff
+};
+static const uint16_t scale3[16] PROGMEM = {
+    0x000, 0x007, 0x038, 0x03f, 0x1c0, 0x1c7, 0x1f8, 0x1ff, 0xe00, 0xe07, 0xe38, 0xe3f, 0xfc0, 0xfc7, 0xff8, 0xfff
+};
+static const uint16_t scale4[16] PROGMEM = {
+    0x0000, 0x000f, 0x00f0, 0x00ff, 0x0f00, 0x0f0f, 0x0ff0, 0x0fff, 0xf000, 0xf00f, 0xf0f0, 0xf0ff, 0xff00, 0xff0f, 0xfff0, 0xffff
+};
+static uint32_t oled_scale_column(uint8_t data, uint8_t scale){
+    switch (scale) {
+        case DOUBLESIZE:
+            return pgm_read_byte(&scale2[data & 0x0f]) | (uint16_t)pgm_read_byte(&scale2[data >> 4]) << 8;
+        case TRIPLESIZE:
+            return pgm_read_word(&scale3[data & 0x0f]) | (uint32_t)pgm_read_word(&scale3[data >> 4]) << 12;
+        case QUADSIZE:
+            return pgm_read_word(&scale4[data & 0x0f]) | (uint32_t)pgm_read_word(&scale4[data >> 4]) << 16;
+        default:
+            return data;
+    }
+}
+// print mapped char c at cursor position, charMode pages high
+static void oled_render_glyph(uint8_t c){
+    uint8_t scale = charMode;
+    uint8_t width = sizeof(FONT[0])*scale;
+    uint32_t column[sizeof(FONT[0])];
+    uint8_t data[sizeof(FONT[0])*QUADSIZE];
+    
+    if (scale < NORMALSIZE || scale > QUADSIZE) return;
+    if ((cursorPosition.x+width)>DISPLAY_WIDTH) return;
+    if ((cursorPosition.y+scale)>DISPLAY_HEIGHT/8) return;
+    
+    for (uint8_t i = 0; i < sizeof(FONT[0]); i++) {
+        // load bit-pattern from flash
+        column[i] = oled_scale_column(pgm_read_byte(&(FONT[c][i])), scale);
+    }
+    for (uint8_t page = 0; page < scale; page++) {
+        uint8_t *d = data;
+        for (uint8_t i = 0; i < sizeof(FONT[0]); i++) {
+            uint8_t b = column[i] >> (8*page);
+            for (uint8_t j = 0; j < scale; j++) *d++ = b;
+        }
+#ifdef GRAPHICMODE
+        for (uint8_t i = 0; i < width; i++) {
+            oled_write_buffer(cursorPosition.x+i, cursorPosition.y+page, data[i]);
+        }
+#elif defined TEXTMODE
+        // normal size continues at the display address
+        if (scale > NORMALSIZE) oled_set_address(cursorPosition.x, cursorPosition.y+page);
+        oled_data(data, width);
+#endif
+    }
+#ifdef TEXTMODE
+    if (scale > NORMALSIZE) oled_set_address(cursorPosition.x+width, cursorPosition.y);
+#endif
+    cursorPosition.x += width;
+}
 void oled_putc(char c){
     switch (c) {
         case '\b':
@@ -267,110 +394,7 @@ void oled_putc(char c){
                 if ( c == 0xff ) break;
             }
             // print char at display
-#ifdef GRAPHICMODE
-            if (charMode == DOUBLESIZE) {
-                uint16_t doubleChar[sizeof(FONT[0])];
-                uint8_t dChar;
-                if ((cursorPosition.x+2*sizeof(FONT[0]))>DISPLAY_WIDTH) break;
-                
-                for (uint8_t i=0; i < sizeof(FONT[0]); i++) {
-                    doubleChar[i] = 0;
-                    dChar = pgm_read_byte(&(FONT[(uint8_t)c][i]));
-                    for (uint8_t j=0; j<8; j++) {
-                        if ((dChar & (1 << j))) {
-                            doubleChar[i] |= (1 << (j*2));
-                            doubleChar[i] |= (1 << ((j*2)+1));
-                        }
-                    }
-                }
-                for (uint8_t i = 0; i < sizeof(FONT[0]); i++)
-                {
-                    // load bit-pattern from flash
-                    displayBuffer[cursorPosition.y+1][cursorPosition.x+(2*i)] = doubleChar[i] >> 8;
-                    displayBuffer[cursorPosition.y+1][cursorPosition.x+(2*i)+1] = doubleChar[i] >> 8;
-                    displayBuffer[cursorPosition.y][cursorPosition.x+(2*i)] = doubleChar[i] & 0xff;
-                    displayBuffer[cursorPosition.y][cursorPosition.x+(2*i)+1] = doubleChar[i] & 0xff;
-                }
-                cursorPosition.x += sizeof(FONT[0])*2;
-            } else {
-            	if ((cursorPosition.x+sizeof(FONT[0]))>DISPLAY_WIDTH) break;
-            	
-                for (uint8_t i = 0; i < sizeof(FONT[0]); i++)
-                {
-                    // load bit-pattern from flash
-                    displayBuffer[cursorPosition.y][cursorPosition.x+i] =pgm_read_byte(&(FONT[(uint8_t)c][i]));
-                }
-                cursorPosition.x += sizeof(FONT[0]);
-            }
-#elif defined TEXTMODE
-            if (charMode == DOUBLESIZE) {
-                uint16_t doubleChar[sizeof(FONT[0])];
-                uint8_t dChar;
-                if ((cursorPosition.x+2*sizeof(FONT[0]))>DISPLAY_WIDTH) break;
-                
-                for (uint8_t i=0; i < sizeof(FONT[0]); i++) {
-                    doubleChar[i] = 0;
-                    dChar = pgm_read_byte(&(FONT[(uint8_t)c][i]));
-                    for (uint8_t j=0; j<8; j++) {
-                        if ((dChar & (1 << j))) {
-                            doubleChar[i] |= (1 << (j*2));
-                            doubleChar[i] |= (1 << ((j*2)+1));
-                        }
-                    }
-                }
-                uint8_t data[sizeof(FONT[0])*2];
-                for (uint8_t i = 0; i < sizeof(FONT[0]); i++)
-                {
-                    // print font to ram, print 6 columns
-                    data[i<<1]=(doubleChar[i] & 0xff);
-                    data[(i<<1)+1]=(doubleChar[i] & 0xff);
-                }
-                oled_data(data, sizeof(FONT[0])*2);
-                
-#if defined (SSD1306) || defined (SSD1309)
-                uint8_t commandSequence[] = {0xb0+cursorPosition.y+1,
-                    0x21,
-                    cursorPosition.x,
-                    0x7f};
-#elif defined SH1106
-                uint8_t commandSequence[] = {0xb0+cursorPosition.y+1,
-                    0x21,
-                    0x00+((2+cursorPosition.x) & (0x0f)),
-                    0x10+( ((2+cursorPosition.x) & (0xf0)) >> 4 ),
-                    0x7f};
-#endif
-                oled_command(commandSequence, sizeof(commandSequence));
-                
-                for (uint8_t i = 0; i < sizeof(FONT[0]); i++)
-                {
-                    // print font to ram, print 6 columns
-                    data[i<<1]=(doubleChar[i] >> 8);
-                    data[(i<<1)+1]=(doubleChar[i] >> 8);
-                }
-                oled_data(data, sizeof(FONT[0])*2);
-                
-                commandSequence[0] = 0xb0+cursorPosition.y;
-#if defined (SSD1306) || defined (SSD1309)
-                commandSequence[2] = cursorPosition.x+(2*sizeof(FONT[0]));
-#elif defined SH1106
-                commandSequence[2] = 0x00+((2+cursorPosition.x+(2*sizeof(FONT[0]))) & (0x0f));
-                commandSequence[3] = 0x10+( ((2+cursorPosition.x+(2*sizeof(FONT[0]))) & (0xf0)) >> 4 );
-#endif
-                oled_command(commandSequence, sizeof(commandSequence));
-                cursorPosition.x += sizeof(FONT[0])*2;
-            } else {
-                uint8_t data[sizeof(FONT[0])];
-                if ((cursorPosition.x+sizeof(FONT[0]))>DISPLAY_WIDTH) break;
-                
-            	for (uint8_t i = 0; i < sizeof(FONT[0]); i++)
-                {
-                    // print font to ram, print 6 columns
-                    data[i]=(pgm_read_byte(&(FONT[(uint8_t)c][i])));
-                }
-                oled_data(data, sizeof(FONT[0]));
-                cursorPosition.x += sizeof(FONT[0]);
-            }
-#endif
+            oled_render_glyph((uint8_t)c);
             break;
     }
     
@@ -406,6 +430,10 @@ void oled_flip(uint8_t flipping){
 			// do nothing
 			break;
 	}
+#ifdef GRAPHICMODE
+	// whole buffer needs to be reloaded by oled_display()
+	if (flipping < 4 && flipping != 2) oled_invalidate();
+#endif
 }
 void oled_puts(const char* s){
     while (*s) {
@@ -424,17 +452,61 @@ void oled_puts_p(const char* progmem_s){
 uint8_t oled_drawPixel(uint8_t x, uint8_t y, uint8_t color){
     if( x > DISPLAY_WIDTH-1 || y > (DISPLAY_HEIGHT-1)) return 1; // out of Display
     
+    uint8_t data = displayBuffer[(y / 8)][x];
     if( color == WHITE){
-        displayBuffer[(y / 8)][x] |= (1 << (y % 8));
+        data |= (1 << (y % 8));
     } else {
-        displayBuffer[(y / 8)][x] &= ~(1 << (y % 8));
+        data &= ~(1 << (y % 8));
     }
+    oled_write_buffer(x, y / 8, data);
     
     return 0;
 }
+// set or clear mask bits in columns x1..x2 of one page
+static void oled_fill_page(uint8_t page, uint8_t x1, uint8_t x2, uint8_t mask, uint8_t color){
+    uint8_t *column = &displayBuffer[page][x1];
+    uint8_t set = (color == WHITE) ? mask : 0x00;
+    uint8_t first = 0xff, last = 0;
+    for (uint8_t x = x1; x <= x2; x++) {
+        uint8_t data = (*column & ~mask) | set;
+        if (data != *column) {
+            *column = data;
+            if (first == 0xff) first = x;
+            last = x;
+        }
+        column++;
+    }
+    if (first <= last) oled_set_dirty(first, last, page);
+}
+// fill rectangle x1..x2, y1..y2 page by page, coordinates are sorted
+static uint8_t oled_fill_span(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t color){
+    uint8_t result = 0;
+    if (x1 > DISPLAY_WIDTH-1 || y1 > DISPLAY_HEIGHT-1) return 1; // out of Display
+    if (x2 > DISPLAY_WIDTH-1) { x2 = DISPLAY_WIDTH-1; result = 1; }
+    if (y2 > DISPLAY_HEIGHT-1) { y2 = DISPLAY_HEIGHT-1; result = 1; }
+    
+    uint8_t page = y1 / 8;
+    uint8_t mask = 0xff << (y1 % 8);
+    while (page < y2 / 8) {
+        oled_fill_page(page, x1, x2, mask, color);
+        page++;
+        mask = 0xff;
+    }
+    mask &= 0xff >> (7 - (y2 % 8));
+    oled_fill_page(page, x1, x2, mask, color);
+    
+    return result;
+}
 uint8_t oled_drawLine(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t color){
 	uint8_t result;
 	
+    // horizontal and vertical lines are written byte by byte
+    if (x1 == x2 || y1 == y2) {
+        oled_fill_span(x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2,
+                       x1 < x2 ? x2 : x1, y1 < y2 ? y2 : y1, color);
+        // result of the last pixel, as drawn by oled_drawPixel()
+        return (x2 > DISPLAY_WIDTH-1 || y2 > (DISPLAY_HEIGHT-1));
+    }
     int dx =  abs(x2-x1), sx = x1<x2 ? 1 : -1;
     int dy = -abs(y2-y1), sy = y1<y2 ? 1 : -1;
     int err = dx+dy, e2; /* error value e_xy */
@@ -460,21 +532,17 @@ uint8_t oled_drawRect(uint8_t px1, uint8_t py1, uint8_t px2, uint8_t py2, uint8_
     return result;
 }
 uint8_t oled_fillRect(uint8_t px1, uint8_t py1, uint8_t px2, uint8_t py2, uint8_t color){
-    uint8_t result;
-    
     if( px1 > px2){
         uint8_t temp = px1;
         px1 = px2;
         px2 = temp;
-        temp = py1;
+    }
+    if( py1 > py2){
+        uint8_t temp = py1;
         py1 = py2;
         py2 = temp;
     }
-    for (uint8_t i=0; i<=(py2-py1); i++){
-        result = oled_drawLine(px1, py1+i, px2, py1+i, color);
-    }
-    
-    return result;
+    return oled_fill_span(px1, py1, px2, py2, color);
 }
 uint8_t oled_drawCircle(uint8_t center_x, uint8_t center_y, uint8_t radius, uint8_t color){
     uint8_t result;
@@ -511,10 +579,41 @@ uint8_t oled_drawCircle(uint8_t center_x, uint8_t center_y, uint8_t radius, uint
     }
     return result;
 }
+// vertical span of fillCircle, clipped to the display
+static uint8_t oled_circle_span(int16_t x, int16_t y1, int16_t y2, uint8_t color){
+    if (x < 0 || x > DISPLAY_WIDTH-1 || y2 < 0) return 1; // out of Display
+    if (y1 < 0) {
+        oled_fill_span(x, 0, x, y2, color);
+        return 1;
+    }
+    return oled_fill_span(x, y1, x, y2 > 0xff ? 0xff : y2, color);
+}
 uint8_t oled_fillCircle(uint8_t center_x, uint8_t center_y, uint8_t radius, uint8_t color) {
     uint8_t result;
-    for(uint8_t i=0; i<= radius;i++){
-        result = oled_drawCircle(center_x, center_y, i, color);
+    
+    // same points as oled_drawCircle, joined by vertical spans
+    int16_t f = 1 - radius;
+    int16_t ddF_x = 1;
+    int16_t ddF_y = -2 * radius;
+    int16_t x = 0;
+    int16_t y = radius;
+    
+    result = oled_circle_span(center_x, center_y-radius, center_y+radius, color);
+    
+    while (x<y) {
+        if (f >= 0) {
+            y--;
+            ddF_y += 2;
+            f += ddF_y;
+        }
+        x++;
+        ddF_x += 2;
+        f += ddF_x;
+        
+        result |= oled_circle_span(center_x + x, center_y - y, center_y + y, color);
+        result |= oled_circle_span(center_x - x, center_y - y, center_y + y, color);
+        result |= oled_circle_span(center_x + y, center_y - x, center_y + x, color);
+        result |= oled_circle_span(center_x - y, center_y - x, center_y + x, color);
     }
     return result;
 }
@@ -531,20 +630,201 @@ uint8_t oled_drawBitmap(uint8_t x, uint8_t y, const uint8_t *picture, uint8_t wi
     }
     return result;
 }
+uint8_t oled_blitBitmap(uint8_t x, uint8_t y, const uint8_t *picture, uint8_t width, uint8_t height, uint8_t mode){
+    uint8_t result = 0;
+    if( x > DISPLAY_WIDTH-1 || y > (DISPLAY_HEIGHT-1) || height == 0) return 1; // out of Display
+    
+    uint8_t columns = width;
+    if (x+width > DISPLAY_WIDTH) { columns = DISPLAY_WIDTH-x; result = 1; }
+    if (y+height > DISPLAY_HEIGHT) result = 1;
+    uint8_t pages = (height+7)/8;
+    uint8_t shift = y % 8;
+    uint8_t lastMask = 0xff >> ((8 - height % 8) % 8);  // rows of the last picture page
+    
+    // every display page is merged from two picture pages shifted by y
+    for (uint8_t p = 0; p <= pages; p++) {
+        uint8_t page = y/8 + p;
+        if (page > DISPLAY_HEIGHT/8-1) break;
+        const uint8_t *low = picture + p*width;    // upper rows of display page
+        uint8_t mask = 0;
+        if (p < pages) mask = (uint8_t)(((p == pages-1) ? lastMask : 0xff) << shift);
+        if (p > 0 && shift) mask |= ((p-1 == pages-1) ? lastMask : 0xff) >> (8-shift);
+        if (mask == 0) continue;
+        
+        if (shift == 0 && mask == 0xff && mode == BITMAP_SOLID) {
+            // whole bytes, page-aligned picture
+            memcpy_P(&displayBuffer[page][x], low, columns);
+            oled_set_dirty(x, x+columns-1, page);
+            continue;
+        }
+        uint8_t *column = &displayBuffer[page][x];
+        uint8_t first = 0xff, last = 0;
+        for (uint8_t i = 0; i < columns; i++) {
+            uint8_t bits = 0;
+            if (p < pages) bits = pgm_read_byte(low+i) << shift;
+            if (p > 0 && shift) {
+                // lower rows of previous picture page
+                bits |= pgm_read_byte(low - width + i) >> (8-shift);
+            }
+            bits &= mask;
+            
+            uint8_t data = *column;
+            if (mode == BITMAP_XOR) {
+                data ^= bits;
+            } else if (mode == BITMAP_TRANSPARENT) {
+                data |= bits;
+            } else {
+                data = (data & ~mask) | bits;
+            }
+            if (data != *column) {
+                *column = data;
+                if (first == 0xff) first = x+i;
+                last = x+i;
+            }
+            column++;
+        }
+        if (first <= last) oled_set_dirty(first, last, page);
+    }
+    return result;
+}
+// move changed columns of page to the columns to be sent
+static void oled_take_dirty(uint8_t page) {
+    if (dirtyRegion[page].first < sendRegion[page].first) sendRegion[page].first = dirtyRegion[page].first;
+    if (dirtyRegion[page].last > sendRegion[page].last) sendRegion[page].last = dirtyRegion[page].last;
+    dirtyRegion[page].first = 0xff;
+    dirtyRegion[page].last = 0;
+}
 void oled_display() {
-#if defined (SSD1306) || defined (SSD1309)
-    oled_gotoxy(0,0);
-    oled_data(&displayBuffer[0][0], DISPLAY_WIDTH*DISPLAY_HEIGHT/8);
-#elif defined SH1106
+    while (oled_busy());
+    // send changed columns of each page only, including pages
+    // which oled_display_async() failed to send
     for (uint8_t i = 0; i < DISPLAY_HEIGHT/8; i++){
-        oled_gotoxy(0,i);
-        oled_data(displayBuffer[i], sizeof(displayBuffer[i]));
+        oled_take_dirty(i);
+        uint8_t first = sendRegion[i].first;
+        uint8_t last = sendRegion[i].last;
+        if (first > last) continue;
+        oled_set_address(first, i);
+        oled_data(&displayBuffer[i][first], last-first+1);
+        dirtyBytes += last-first+1;
+        sendRegion[i].first = 0xff;
+        sendRegion[i].last = 0;
     }
+}
+void oled_invalidate() {
+    for (uint8_t i = 0; i < DISPLAY_HEIGHT/8; i++){
+        dirtyRegion[i].first = 0;
+        dirtyRegion[i].last = DISPLAY_WIDTH-1;
+    }
+}
+uint32_t oled_dirty_bytes() {
+    uint32_t bytes;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        bytes = dirtyBytes;
+    }
+    return bytes;
+}
+// send the next page of oled_display_async(), called from interrupt
+static void oled_send_next(void) {
+    uint8_t page = sendPage;
+    while (++page < DISPLAY_HEIGHT/8) {
+        uint8_t first = sendRegion[page].first;
+        uint8_t last = sendRegion[page].last;
+        if (first > last) continue;
+        sendPage = page;
+#if defined I2C
+        // commands and data in one transaction, Co bit set before each command
+        uint8_t commandSequence[7];
+        uint8_t n = oled_address_sequence(first, page, commandSequence);
+        for (uint8_t i = 0; i < n; i++) {
+            sendHeader[2*i] = 0x80;
+            sendHeader[2*i+1] = commandSequence[i];
+        }
+        sendHeader[2*n] = 0x40;
+        sendXfer.wlen = 2*n+1;
+        sendXfer.wbuf2 = &displayBuffer[page][first];
+        sendXfer.wlen2 = last-first+1;
+        if (twi_submit(&sendXfer)) return;
+        // queue is full, page is sent at the next frame
+#elif defined SPI
+        sendCommandLength = oled_address_sequence(first, page, sendCommand);
+        sendLength = sendCommandLength + last-first+1;
+        sendIndex = 1;
+        OLED_PORT &= ~(1 << CS_PIN);
+        OLED_PORT &= ~(1 << DC_PIN);
+        SPCR |= (1 << SPIE);
+        SPDR = sendCommand[0];
+        return;
 #endif
+    }
+#if defined SPI
+    SPCR &= ~(1 << SPIE);
+#endif
+    sendPage = DISPLAY_HEIGHT/8;
+    if (sendCallback) sendCallback();
+}
+// page has been sent, or sending has failed
+static void oled_send_page_done(uint8_t ok) {
+    uint8_t page = sendPage;
+    if (ok) {
+        dirtyBytes += sendRegion[page].last-sendRegion[page].first+1;
+        sendRegion[page].first = 0xff;
+        sendRegion[page].last = 0;
+    }
+    oled_send_next();
+}
+#if defined I2C
+static void oled_send_done(twi_xfer_t *x) {
+    oled_send_page_done(x->status == TWI_XFER_OK);
+}
+#elif defined SPI
+ISR(SPI_STC_vect) {
+    uint8_t i = sendIndex;
+    if (i < sendCommandLength) {
+        SPDR = sendCommand[i];
+    } else if (i < sendLength) {
+        uint8_t page = sendPage;
+        if (i == sendCommandLength) OLED_PORT |= (1 << DC_PIN);
+        SPDR = displayBuffer[page][sendRegion[page].first + i-sendCommandLength];
+    } else {
+        OLED_PORT |= (1 << CS_PIN);
+        oled_send_page_done(1);
+        return;
+    }
+    sendIndex = i+1;
+}
+#endif
+uint8_t oled_display_async(void (*callback)(void)) {
+    if (oled_busy()) return 0;
+    // snapshot of changed columns, drawing during transfer marks them again
+    for (uint8_t i = 0; i < DISPLAY_HEIGHT/8; i++){
+        oled_take_dirty(i);
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        sendCallback = NULL;
+        sendPage = 0xff;  // next page is 0
+        oled_send_next();
+        if (oled_busy()) {
+            // completion is reported from interrupt
+            sendCallback = callback;
+            return 1;
+        }
+    }
+    // nothing is being sent, pages not queued are kept for next call
+    for (uint8_t i = 0; i < DISPLAY_HEIGHT/8; i++){
+        if (sendRegion[i].first <= sendRegion[i].last) return 0;
+    }
+    if (callback) callback();
+    return 1;
+}
+uint8_t oled_busy() {
+    return sendPage != DISPLAY_HEIGHT/8;
 }
 void oled_clear_buffer() {
     for (uint8_t i = 0; i < DISPLAY_HEIGHT/8; i++){
-        memset(displayBuffer[i], 0x00, sizeof(displayBuffer[i]));
+        // only columns which are not blank yet become dirty
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            oled_write_buffer(x, i, 0x00);
+        }
     }
 }
 uint8_t oled_check_buffer(uint8_t x, uint8_t y) {
@@ -556,7 +836,7 @@ void oled_display_block(uint8_t x, uint8_t line, uint8_t width) {
     if (x + width > DISPLAY_WIDTH) { // no -1 here, x alone is width 1
         width = DISPLAY_WIDTH - x;
     }
-    oled_goto_xpix_y(x,line);
+    oled_set_address(x,line);
     oled_data(&displayBuffer[line][x], width);
 }
 #endif
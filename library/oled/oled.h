@@ -68,6 +68,9 @@ extern "C" {
     // using 7-bit-adress for lcd-library
     // if you use your own library for twi check I2C-adress-handle
 #define OLED_I2C_ADR (0x3c)  // 7 bit slave-adress without r/w-bit
+#ifndef OLED_I2C_HZ
+# define OLED_I2C_HZ 400000  // SCL frequency of oled_display_async()
+#endif
     // e.g. 8 bit slave-adress:
     // 0x78 = adress 0x3C with cleared r/w-bit (write-mode)
 
@@ -90,12 +93,18 @@ extern "C" {
 
 #define NORMALSIZE 1
 #define DOUBLESIZE 2
+#define TRIPLESIZE 3
+#define QUADSIZE 4
     
 #define OLED_DISP_OFF 0xAE
 #define OLED_DISP_ON 0xAF
     
 #define WHITE 0x01
 #define BLACK 0x00
+
+#define BITMAP_SOLID 0        // oled_blitBitmap() overwrites the area of picture
+#define BITMAP_TRANSPARENT 1  // only set bits of picture are drawn
+#define BITMAP_XOR 2          // set bits of picture invert the pixels
     
 #define DISPLAY_WIDTH 128
 #define DISPLAY_HEIGHT 64
@@ -120,7 +129,7 @@ void oled_goto_xpix_y(uint8_t x, uint8_t y); // set curser at pos x, y. x means
 // y means line (page, refer lcd manual)
 void oled_putc(char c);  // print character on screen at TEXTMODE
 // at GRAPHICMODE print character to buffer
-void oled_charMode(uint8_t mode);  // set size of chars
+void oled_charMode(uint8_t mode);  // set size of chars, NORMALSIZE to QUADSIZE
 void oled_flip(uint8_t flipping);  // flip display, 
                     // flipping == 0: no flip (normal mode) 
                         // == 1: flip horizontal & vertical
@@ -133,8 +142,22 @@ void oled_flip(uint8_t flipping);  // flip display,
     uint8_t oled_fillRect(uint8_t px1, uint8_t py1, uint8_t px2, uint8_t py2, uint8_t color);
     uint8_t oled_drawCircle(uint8_t center_x, uint8_t center_y, uint8_t radius, uint8_t color);
     uint8_t oled_fillCircle(uint8_t center_x, uint8_t center_y, uint8_t radius, uint8_t color);
+                        // returns 1 if any part of the circle is out of display
     uint8_t oled_drawBitmap(uint8_t x, uint8_t y, const uint8_t picture[], uint8_t width, uint8_t height, uint8_t color);
-    void oled_display(void);       // copy buffer to display RAM
+    uint8_t oled_blitBitmap(uint8_t x, uint8_t y, const uint8_t picture[], uint8_t width, uint8_t height, uint8_t mode);
+                        // picture from flash in display layout: (height+7)/8 pages of width bytes,
+                        // bit 0 is top row, see tools/oled_bitmap; mode is BITMAP_SOLID,
+                        // BITMAP_TRANSPARENT or BITMAP_XOR
+    void oled_display(void);       // copy changed parts of buffer to display RAM
+    void oled_invalidate(void);    // mark whole buffer as changed, next oled_display() sends all
+    uint32_t oled_dirty_bytes(void);  // number of data bytes sent by oled_display() so far
+    uint8_t oled_display_async(void (*callback)(void));  // send changed parts of buffer in background,
+                        // callback (or NULL) is called from interrupt when done, or before
+                        // return if nothing has changed; returns 0 if previous transfer is
+                        // still running or the TWI queue is full (callback is not called)
+    uint8_t oled_busy(void);  // 1 while oled_display_async() is sending; oled_clrscr(),
+                        // oled_display() and all commands wait for the end of the transfer,
+                        // so do not call them from the callback
     void oled_clear_buffer(void);  // clear display buffer
     uint8_t oled_check_buffer(uint8_t x, uint8_t y); // read a pixel value from the display buffer
     void oled_display_block(uint8_t x, uint8_t line, uint8_t width); // display (part of) a display line
@@ -0,0 +1,284 @@
+/*
+ * Software I2C master library for AVR-GCC.
+ * (c) 2025 Tomas Fryza, MIT license
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+// -- Includes ---------------------------------------------
+#include <soft_twi.h>
+#include <util/delay.h>
+
+
+// -- Defines ----------------------------------------------
+// Open-drain lines: low is driven by DDR, high is released to pull-up.
+// With constant port and pins every line change is two sbi/cbi.
+#define SDA_LOW()  do { SOFT_TWI_PORT &= ~(1<<SOFT_TWI_SDA_PIN); DDR(SOFT_TWI_PORT) |= (1<<SOFT_TWI_SDA_PIN); } while (0)
+#define SDA_HIGH() do { DDR(SOFT_TWI_PORT) &= ~(1<<SOFT_TWI_SDA_PIN); SOFT_TWI_PORT |= (1<<SOFT_TWI_SDA_PIN); } while (0)
+#define SCL_LOW()  do { SOFT_TWI_PORT &= ~(1<<SOFT_TWI_SCL_PIN); DDR(SOFT_TWI_PORT) |= (1<<SOFT_TWI_SCL_PIN); } while (0)
+#define SDA_READ() (PIN(SOFT_TWI_PORT) & (1<<SOFT_TWI_SDA_PIN))
+
+#if SOFT_TWI_DELAY_US > 0
+# define SOFT_TWI_DELAY() _delay_us(SOFT_TWI_DELAY_US)
+#else
+# define SOFT_TWI_DELAY()
+#endif
+
+// Clock stretching wait loops per TWI_TIMEOUT_US, one loop takes 6 cycles
+#define SOFT_TWI_TIMEOUT_LOOPS (F_CPU / 1000000UL * TWI_TIMEOUT_US / 6)
+#if (SOFT_TWI_TIMEOUT_LOOPS > 65535)
+# error TWI_TIMEOUT_US out of range
+#endif
+
+
+// -- Global variables -------------------------------------
+static uint8_t soft_twi_addr_byte;  // Next written byte is SLA+R/W
+static uint8_t soft_twi_last_status;  // Status of last start, write, or read
+
+
+// -- Local functions --------------------------------------
+/*
+ * Function: scl_high()
+ * Purpose:  Release SCL and wait while a slave stretches the clock.
+ * Returns:  0 or TWI_ERR_TIMEOUT
+ */
+static inline uint8_t scl_high(void)
+{
+    uint16_t loops = SOFT_TWI_TIMEOUT_LOOPS;
+
+    DDR(SOFT_TWI_PORT) &= ~(1<<SOFT_TWI_SCL_PIN);
+    SOFT_TWI_PORT |= (1<<SOFT_TWI_SCL_PIN);
+    while (!(PIN(SOFT_TWI_PORT) & (1<<SOFT_TWI_SCL_PIN))) {
+        if (--loops == 0)
+            return TWI_ERR_TIMEOUT;
+    }
+    return TWI_XFER_OK;
+}
+
+
+// -- Functions --------------------------------------------
+/*
+ * Function: soft_twi_init()
+ * Purpose:  Release both lines and enable internal pull-ups.
+ * Returns:  none
+ */
+void soft_twi_init(void)
+{
+    DDR(SOFT_TWI_PORT) &= ~((1<<SOFT_TWI_SDA_PIN) | (1<<SOFT_TWI_SCL_PIN));
+    SOFT_TWI_PORT |= (1<<SOFT_TWI_SDA_PIN) | (1<<SOFT_TWI_SCL_PIN);
+}
+
+
+/*
+ * Function: soft_twi_start()
+ * Purpose:  Generate START or repeated START condition.
+ * Returns:  Status code, 0 if START has been generated
+ */
+uint8_t soft_twi_start(void)
+{
+    /* SDA falls while SCL is high */
+    SDA_HIGH();
+    SOFT_TWI_DELAY();
+    if (scl_high() != TWI_XFER_OK)
+        return soft_twi_last_status = TWI_ERR_TIMEOUT;
+    SOFT_TWI_DELAY();
+    SDA_LOW();
+    SOFT_TWI_DELAY();
+    SCL_LOW();
+
+    soft_twi_addr_byte = 1;
+    return soft_twi_last_status = TWI_XFER_OK;
+}
+
+
+/*
+ * Function: soft_twi_write()
+ * Purpose:  Write one byte to the bus, MSB first.
+ * Input:    data Byte to be transmitted
+ * Returns:  Status code, 0 if ACK has been received
+ */
+uint8_t soft_twi_write(uint8_t data)
+{
+    uint8_t i;
+    uint8_t nack;
+    uint8_t twi_status;
+
+    /* Status code for NACK, same as TWSR of TWI unit */
+    if (soft_twi_addr_byte)
+        twi_status = (data & TWI_READ) ? 0x48 : 0x20;
+    else
+        twi_status = 0x30;
+    soft_twi_addr_byte = 0;
+
+    for (i = 8; i != 0; i--) {
+        if (data & 0x80)
+            SDA_HIGH();
+        else
+            SDA_LOW();
+        data <<= 1;
+        SOFT_TWI_DELAY();
+        if (scl_high() != TWI_XFER_OK)
+            return soft_twi_last_status = TWI_ERR_TIMEOUT;
+        SOFT_TWI_DELAY();
+        SCL_LOW();
+    }
+
+    /* ACK bit is driven by slave */
+    SDA_HIGH();
+    SOFT_TWI_DELAY();
+    if (scl_high() != TWI_XFER_OK)
+        return soft_twi_last_status = TWI_ERR_TIMEOUT;
+    nack = SDA_READ();
+    SOFT_TWI_DELAY();
+    SCL_LOW();
+
+    return soft_twi_last_status = nack ? twi_status : TWI_XFER_OK;
+}
+
+
+/*
+ * Function: soft_twi_read()
+ * Purpose:  Read one byte from the bus and acknowledge it by ACK or NACK.
+ * Input:    ack ACK/NACK value to be transmitted
+ * Returns:  Received data byte, see soft_twi_get_status() for timeout
+ */
+uint8_t soft_twi_read(uint8_t ack)
+{
+    uint8_t i;
+    uint8_t data = 0;
+
+    soft_twi_last_status = TWI_ERR_TIMEOUT;
+    SDA_HIGH();
+    for (i = 8; i != 0; i--) {
+        data <<= 1;
+        SOFT_TWI_DELAY();
+        if (scl_high() != TWI_XFER_OK)
+            return 0xff;
+        if (SDA_READ())
+            data |= 1;
+        SOFT_TWI_DELAY();
+        SCL_LOW();
+    }
+
+    /* ACK bit is driven by master */
+    if (ack == TWI_ACK)
+        SDA_LOW();
+    SOFT_TWI_DELAY();
+    if (scl_high() != TWI_XFER_OK) {
+        SDA_HIGH();
+        return data;
+    }
+    SOFT_TWI_DELAY();
+    SCL_LOW();
+    SDA_HIGH();
+
+    soft_twi_last_status = TWI_XFER_OK;
+    return data;
+}
+
+
+/*
+ * Function: soft_twi_get_status()
+ * Purpose:  Get status of the last start, write, or read.
+ * Returns:  Status code, 0 on success
+ */
+uint8_t soft_twi_get_status(void)
+{
+    return soft_twi_last_status;
+}
+
+
+/*
+ * Function: soft_twi_stop()
+ * Purpose:  Generate STOP condition.
+ * Returns:  none
+ */
+void soft_twi_stop(void)
+{
+    /* SDA rises while SCL is high */
+    SDA_LOW();
+    SOFT_TWI_DELAY();
+    scl_high();
+    SOFT_TWI_DELAY();
+    SDA_HIGH();
+    SOFT_TWI_DELAY();
+}
+
+
+/*
+ * Function: soft_twi_test_address()
+ * Purpose:  Test presence of one I2C device on the bus.
+ * Input:    addr Slave address
+ * Returns:  Status code, 0 if ACK has been received
+ */
+uint8_t soft_twi_test_address(uint8_t addr)
+{
+    uint8_t ack;  // ACK response from Slave
+
+    ack = soft_twi_start();
+    if (ack == TWI_XFER_OK)
+        ack = soft_twi_write((addr<<1) | TWI_WRITE);
+    soft_twi_stop();
+
+    return ack;
+}
+
+
+/*
+ * Function: soft_twi_readfrom_mem_into()
+ * Purpose:  Read into buf from the peripheral starting from the memory
+ *           address, using repeated START.
+ * Input:    addr Slave address
+ *           memaddr Starting address
+ *           buf Buffer to be read into
+ *           nbytes Number of bytes
+ * Returns:  Status code, 0 on success
+ */
+uint8_t soft_twi_readfrom_mem_into(uint8_t addr, uint8_t memaddr, volatile uint8_t *buf, uint8_t nbytes)
+{
+    uint8_t twi_status;
+
+    twi_status = soft_twi_start();
+    if (twi_status == TWI_XFER_OK)
+        twi_status = soft_twi_write((addr<<1) | TWI_WRITE);
+    if (twi_status == TWI_XFER_OK)
+        twi_status = soft_twi_write(memaddr);
+    if (twi_status == TWI_XFER_OK)
+        twi_status = soft_twi_start();
+    if (twi_status == TWI_XFER_OK)
+        twi_status = soft_twi_write((addr<<1) | TWI_READ);
+    while (twi_status == TWI_XFER_OK && nbytes--) {
+        *buf++ = soft_twi_read(nbytes ? TWI_ACK : TWI_NACK);
+        twi_status = soft_twi_last_status;
+    }
+    soft_twi_stop();
+
+    return twi_status;
+}
+
+
+/*
+ * Function: soft_twi_writeto_mem()
+ * Purpose:  Write buf to the peripheral starting from the memory address.
+ * Input:    addr Slave address
+ *           memaddr Starting address
+ *           buf Data to be written
+ *           nbytes Number of bytes
+ * Returns:  Status code, 0 on success
+ */
+uint8_t soft_twi_writeto_mem(uint8_t addr, uint8_t memaddr, const uint8_t *buf, uint8_t nbytes)
+{
+    uint8_t twi_status;
+
+    twi_status = soft_twi_start();
+    if (twi_status == TWI_XFER_OK)
+        twi_status = soft_twi_write((addr<<1) | TWI_WRITE);
+    if (twi_status == TWI_XFER_OK)
+        twi_status = soft_twi_write(memaddr);
+    while (twi_status == TWI_XFER_OK && nbytes--)
+        twi_status = soft_twi_write(*buf++);
+    soft_twi_stop();
+
+    return twi_status;
+}
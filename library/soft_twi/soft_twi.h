@@ -0,0 +1,154 @@
+#ifndef SOFT_TWI_H
+#define SOFT_TWI_H
+
+/*
+ * Software I2C master library for AVR-GCC.
+ * (c) 2025 Tomas Fryza, MIT license
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+/**
+ * @file 
+ * @defgroup fryza_soft_twi Software I2C Library <soft_twi.h>
+ * @code #include <soft_twi.h> @endcode
+ *
+ * @brief Bit-banged I2C master on any two GPIO pins.
+ *
+ * Second I2C bus with the same API as the blocking functions of
+ * <twi.h>, e.g. for devices with conflicting addresses or devices
+ * which do not support the clock of the main bus. Port and pins are
+ * compile-time constants, add CDEFS += -DSOFT_TWI_PORT=PORTD
+ * -DSOFT_TWI_SDA_PIN=2 -DSOFT_TWI_SCL_PIN=3 to your Makefile (or
+ * build_flags in platformio.ini) to change them. Both lines are
+ * open-drain: a line is driven low by its DDR bit only, and released
+ * to the internal and external pull-up. Clock stretching by slaves is
+ * supported.
+ *
+ * Throughput at 16 MHz, estimated from instruction counts (about 23
+ * cycles per bit plus 2*SOFT_TWI_DELAY_US, 30 cycles per byte call):
+ *   - SOFT_TWI_DELAY_US = 4: SCL about 105 kHz, 11 kB/s
+ *   - SOFT_TWI_DELAY_US = 1: SCL about 290 kHz, 30 kB/s
+ *   - SOFT_TWI_DELAY_US = 0: SCL about 700 kHz, 65 kB/s (slaves must
+ *     support Fast-mode Plus or stretch the clock)
+ *
+ * @note Status codes are the same as in <twi.h>.
+ * @copyright (c) 2025 Tomas Fryza, MIT license
+ * @{
+ */
+
+// -- Includes ---------------------------------------------
+#include <avr/io.h>
+#include <twi.h>
+
+
+// -- Defines ----------------------------------------------
+/**
+ * @name Definition of ports and pins
+ */
+#ifndef SOFT_TWI_PORT
+#define SOFT_TWI_PORT PORTB /**< @brief Port of both lines */
+#endif
+#ifndef SOFT_TWI_SDA_PIN
+#define SOFT_TWI_SDA_PIN 0 /**< @brief SDA pin, Arduino Uno D8 */
+#endif
+#ifndef SOFT_TWI_SCL_PIN
+#define SOFT_TWI_SCL_PIN 1 /**< @brief SCL pin, Arduino Uno D9 */
+#endif
+
+
+/**
+ * @name Definition of timing
+ */
+#ifndef SOFT_TWI_DELAY_US
+#define SOFT_TWI_DELAY_US 4 /**< @brief Additional delay of each SCL half period in microseconds */
+#endif
+
+
+// -- Function prototypes ----------------------------------
+/**
+ * @brief  Release both lines and enable internal pull-ups.
+ * @return none
+ */
+void soft_twi_init(void);
+
+
+/**
+ * @brief  Generate START or repeated START condition.
+ * @return Status code
+ * @retval 0 - START has been generated
+ * @retval TWI_ERR_TIMEOUT - SCL is held low by other device
+ */
+uint8_t soft_twi_start(void);
+
+
+/**
+ * @brief  Write one byte to the bus.
+ * @param  data Byte to be transmitted
+ * @return Status code
+ * @retval 0 - ACK has been received
+ * @retval 0x20, 0x30, 0x48 - NACK has been received after SLA+W, data, or SLA+R
+ * @retval TWI_ERR_TIMEOUT - SCL is held low by other device
+ */
+uint8_t soft_twi_write(uint8_t data);
+
+
+/**
+ * @brief  Read one byte from the bus and acknowledge it by ACK or NACK.
+ * @param  ack - ACK/NACK value to be transmitted
+ * @return Received data byte, see soft_twi_get_status() for errors
+ */
+uint8_t soft_twi_read(uint8_t ack);
+
+
+/**
+ * @brief  Get status of the last soft_twi_start(), soft_twi_write(), or
+ *         soft_twi_read().
+ * @return Status code, 0 on success or TWI_ERR_TIMEOUT if SCL is held
+ *         low by other device
+ */
+uint8_t soft_twi_get_status(void);
+
+
+/**
+ * @brief  Generate STOP condition.
+ * @return none
+ */
+void soft_twi_stop(void);
+
+
+/**
+ * @brief  Test presence of one I2C device on the bus.
+ * @param  addr Slave address
+ * @return Status code, 0 if ACK has been received
+ */
+uint8_t soft_twi_test_address(uint8_t addr);
+
+
+/**
+ * @brief  Read into buf from the peripheral, starting from the memory
+ *         address. Data are read after a repeated START.
+ * @param  addr Slave address
+ * @param  memaddr Starting address
+ * @param  buf Buffer to be read into
+ * @param  nbytes Number of bytes
+ * @return Status code, 0 on success, NACK status code, or TWI_ERR_TIMEOUT
+ *         if SCL is held low; reading stops at the first error
+ */
+uint8_t soft_twi_readfrom_mem_into(uint8_t addr, uint8_t memaddr, volatile uint8_t *buf, uint8_t nbytes);
+
+
+/**
+ * @brief  Write buf to the peripheral, starting from the memory address.
+ * @param  addr Slave address
+ * @param  memaddr Starting address
+ * @param  buf Data to be written
+ * @param  nbytes Number of bytes
+ * @return Status code, 0 on success
+ */
+uint8_t soft_twi_writeto_mem(uint8_t addr, uint8_t memaddr, const uint8_t *buf, uint8_t nbytes);
+
+/** @} */
+
+#endif
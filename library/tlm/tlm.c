@@ -0,0 +1,141 @@
+/*
+ * Binary telemetry library for AVR-GCC.
+ * (c) 2025 Tomas Fryza, MIT license
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+// -- Includes ---------------------------------------------
+#include <tlm.h>
+#include <uart.h>
+#include <util/crc16.h>
+
+
+// -- Global variables -------------------------------------
+static uint16_t tlm_len;    // Staged bytes of current COBS block, incl. code byte
+static uint8_t tlm_code;    // COBS code of current block
+static uint16_t tlm_crc;    // CRC of the payload
+static uint8_t tlm_error;   // Transmit buffer overflow within packet
+
+
+// -- Local functions --------------------------------------
+/*
+ * Function: tlm_stage()
+ * Purpose:  Store one byte behind the published data in UART buffer.
+ * Input(s): value - Byte to be stored
+ * Returns:  none
+ */
+static void tlm_stage(uint8_t value)
+{
+    if (uart_tx_stage(tlm_len, value))
+        tlm_len++;
+    else
+        tlm_error = 1;
+}
+
+
+/*
+ * Function: tlm_encode()
+ * Purpose:  COBS-encode one byte. A block ends at each zero byte or
+ *           after 254 non-zero bytes; its code byte at offset 0 is
+ *           patched and the block is sent.
+ * Input(s): value - Byte to be encoded
+ * Returns:  none
+ */
+static void tlm_encode(uint8_t value)
+{
+    if (tlm_error)
+        return;
+
+    if (value != 0) {
+        tlm_stage(value);
+        tlm_code++;
+    }
+
+    if (value == 0 || tlm_code == 0xff) {
+        uart_tx_stage(0, tlm_code);
+        uart_tx_commit(tlm_len);
+
+        // Start next block with a placeholder for its code byte
+        tlm_len = 0;
+        tlm_code = 1;
+        tlm_stage(0xff);
+    }
+}
+
+
+// -- Function definitions ---------------------------------
+/*
+ * Function: tlm_begin()
+ * Purpose:  Start a new packet.
+ * Returns:  none
+ */
+void tlm_begin(void)
+{
+    tlm_len = 0;
+    tlm_code = 1;
+    tlm_crc = 0xffff;
+    tlm_error = 0;
+
+    // Placeholder for the first code byte
+    tlm_stage(0xff);
+}
+
+
+/*
+ * Function: tlm_u8()
+ * Purpose:  Append one byte to the packet.
+ * Input(s): value - Byte to be appended
+ * Returns:  none
+ */
+void tlm_u8(uint8_t value)
+{
+    tlm_crc = _crc_xmodem_update(tlm_crc, value);
+    tlm_encode(value);
+}
+
+
+/*
+ * Function: tlm_u16()
+ * Purpose:  Append one 16-bit value to the packet, little endian.
+ * Input(s): value - Value to be appended
+ * Returns:  none
+ */
+void tlm_u16(uint16_t value)
+{
+    tlm_u8(value & 0xff);
+    tlm_u8(value >> 8);
+}
+
+
+/*
+ * Function: tlm_end()
+ * Purpose:  Append CRC and delimiter and send the packet.
+ * Returns:  1 if the packet was queued, 0 on buffer overflow
+ */
+uint8_t tlm_end(void)
+{
+    uint16_t crc = tlm_crc;
+
+    tlm_encode(crc & 0xff);
+    tlm_encode(crc >> 8);
+
+    if (tlm_error) {
+        // Drop the unsent block and terminate what was already sent.
+        // The delimiter must not be dropped, otherwise the next packet
+        // is merged with this one; wait for one free byte.
+        while (!uart_tx_stage(0, 0x00))
+            ;
+        uart_tx_commit(1);
+        return 0;
+    }
+
+    // Last block and delimiter, which must not be dropped either
+    uart_tx_stage(0, tlm_code);
+    while (!uart_tx_stage(tlm_len, 0x00))
+        ;
+    uart_tx_commit(tlm_len + 1);
+
+    return 1;
+}
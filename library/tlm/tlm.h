@@ -0,0 +1,81 @@
+#ifndef TLM_H
+#define TLM_H
+
+/*
+ * Binary telemetry library for AVR-GCC.
+ * (c) 2025 Tomas Fryza, MIT license
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+/**
+ * @file 
+ * @defgroup fryza_tlm Telemetry Library <tlm.h>
+ * @code #include <tlm.h> @endcode
+ *
+ * @brief Binary framed telemetry over the UART library.
+ *
+ * Packets are built value by value and encoded on the fly with COBS
+ * (Consistent Overhead Byte Stuffing) directly into the UART transmit
+ * buffer, no intermediate packet buffer is used. Every packet ends with
+ * CRC-16/CCITT-FALSE of the payload (little endian) and a 0x00 delimiter:
+ *
+ *     COBS(payload, crc_lo, crc_hi) 0x00
+ *
+ * Compared to sprintf() and uart_puts(), a DHT12 sample of 5 bytes
+ * takes 9 bytes on the line (5 + 2 CRC + 1 COBS code + 1 delimiter)
+ * instead of about 30. Use host program
+ * tools/tlm_decode to decode the packets on Linux.
+ *
+ * @note Only one packet can be built at a time, do not call the functions
+ *       from an ISR while the main loop builds a packet. A COBS block of up
+ *       to 254 non-zero bytes stays in the transmit buffer until it is
+ *       complete, so UART0_TX_BUFFER_SIZE limits the run of non-zero bytes.
+ * @copyright (c) 2025 Tomas Fryza, MIT license
+ * @{
+ */
+
+// -- Includes ---------------------------------------------
+#include <avr/io.h>
+
+
+// -- Function prototypes ----------------------------------
+/**
+ * @brief  Start a new packet.
+ * @return none
+ */
+void tlm_begin(void);
+
+
+/**
+ * @brief  Append one byte to the packet.
+ * @param  value Byte to be appended
+ * @return none
+ */
+void tlm_u8(uint8_t value);
+
+
+/**
+ * @brief  Append one 16-bit value to the packet, little endian.
+ * @param  value Value to be appended
+ * @return none
+ */
+void tlm_u16(uint16_t value);
+
+
+/**
+ * @brief  Append CRC and delimiter and send the packet.
+ * @return Packet status
+ * @retval 1 - Packet queued
+ * @retval 0 - Transmit buffer overflow, packet truncated and
+ *             terminated, the receiver drops it due to CRC
+ * @note   The delimiter is never dropped: the function waits for one
+ *         free byte of the transmit buffer for it, so interrupts must
+ *         be enabled.
+ */
+uint8_t tlm_end(void);
+
+/** @} */
+
+#endif
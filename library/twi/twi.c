@@ -8,6 +8,453 @@
 
 // -- Includes ---------------------------------------------
 #include <twi.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <util/delay.h>
+
+
+// -- Defines ----------------------------------------------
+#define TWI_QUEUE_MASK (TWI_QUEUE_SIZE - 1)
+#if (TWI_QUEUE_SIZE & TWI_QUEUE_MASK)
+# error TWI_QUEUE_SIZE is not a power of 2
+#endif
+
+// TWCR value which continues the transaction and keeps interrupt enabled
+#define TWI_CR_NEXT ((1<<TWINT) | (1<<TWEN) | (1<<TWIE))
+
+// Wait loops per TWI_TIMEOUT_US. Divisors are the cycles of the fastest
+// path of each loop, so the timeout is never shorter than TWI_TIMEOUT_US:
+// twi_wait_int() tests TWINT in about 7 cycles, twi_wait() calls
+// twi_poll() and tests status, events, and backoff in about 30 cycles
+#define TWI_INT_LOOP_CYCLES 6
+#define TWI_WAIT_LOOP_CYCLES 24
+#define TWI_INT_LOOPS (F_CPU / 1000000UL * TWI_TIMEOUT_US / TWI_INT_LOOP_CYCLES)
+#define TWI_TIMEOUT_LOOPS (F_CPU / 1000000UL * TWI_TIMEOUT_US / TWI_WAIT_LOOP_CYCLES)
+#if (TWI_INT_LOOPS > 65535) || (TWI_TIMEOUT_LOOPS == 0)
+# error TWI_TIMEOUT_US out of range
+#endif
+
+// Wait loops of twi_wait() per backoff unit in blocking functions
+#define TWI_BACKOFF_LOOPS (F_CPU / 1000000UL * TWI_BACKOFF_US / TWI_WAIT_LOOP_CYCLES)
+#if (TWI_BACKOFF_LOOPS > 65535) || (TWI_BACKOFF_LOOPS == 0)
+# error TWI_BACKOFF_US out of range
+#endif
+
+
+// -- Global variables -------------------------------------
+// Chip ID registers of common parts, see twi_identify()
+static const char twi_name_bmp280[] PROGMEM = "BMP280";
+static const char twi_name_bme280[] PROGMEM = "BME280";
+static const char twi_name_bme680[] PROGMEM = "BME680";
+static const char twi_name_mpu6050[] PROGMEM = "MPU-6050";
+static const char twi_name_mpu6500[] PROGMEM = "MPU-6500";
+static const char twi_name_mpu9250[] PROGMEM = "MPU-9250";
+static const char twi_name_hmc5883l[] PROGMEM = "HMC5883L";
+static const char twi_name_adxl345[] PROGMEM = "ADXL345";
+
+static const struct {
+    uint8_t addr;               // Slave address
+    uint8_t reg;                // Chip ID register
+    uint8_t id;                 // Expected value
+    const char *name;           // Name in program memory
+} twi_ids[] PROGMEM = {
+    {0x76, 0xd0, 0x58, twi_name_bmp280},
+    {0x76, 0xd0, 0x60, twi_name_bme280},
+    {0x76, 0xd0, 0x61, twi_name_bme680},
+    {0x77, 0xd0, 0x58, twi_name_bmp280},
+    {0x77, 0xd0, 0x60, twi_name_bme280},
+    {0x77, 0xd0, 0x61, twi_name_bme680},
+    {0x68, 0x75, 0x68, twi_name_mpu6050},
+    {0x68, 0x75, 0x70, twi_name_mpu6500},
+    {0x68, 0x75, 0x71, twi_name_mpu9250},
+    {0x69, 0x75, 0x68, twi_name_mpu6050},
+    {0x69, 0x75, 0x70, twi_name_mpu6500},
+    {0x69, 0x75, 0x71, twi_name_mpu9250},
+    {0x1e, 0x0a, 0x48, twi_name_hmc5883l},
+    {0x1d, 0x00, 0xe5, twi_name_adxl345},
+    {0x53, 0x00, 0xe5, twi_name_adxl345},
+};
+
+
+static twi_xfer_t *twi_queue[TWI_QUEUE_SIZE];   // Queued transactions
+static volatile uint8_t twi_queue_head;         // Index of last queued transaction
+static volatile uint8_t twi_queue_tail;         // Index of last finished transaction
+static volatile uint8_t twi_running;            // Transaction in progress
+static volatile uint8_t twi_owned;              // Bus used by blocking functions, queue waits
+static volatile uint8_t twi_recovering;         // Bus recovery of twi_engine_abort() in progress
+static uint8_t twi_phase;                       // TWI_WRITE or TWI_READ part of transaction
+static uint16_t twi_idx;                        // Byte index within current part
+static uint16_t twi_clock_default;              // Bit rate for blocking functions
+static volatile uint8_t twi_events;             // Bus events counter for timeouts
+static uint8_t twi_last_status;                 // Status of last blocking function
+static uint8_t twi_cr_idle = (1<<TWEN);         // TWCR value when not in master mode
+static volatile uint8_t twi_start_pending;      // START deferred until slave transfer ends
+static volatile uint8_t twi_backoff;            // Backoff units until retry after lost arbitration
+static twi_stats_t twi_stats;                   // Multi-master counters
+
+static volatile uint8_t *twi_slave_regs;        // Register file of slave mode
+static uint8_t twi_slave_size;                  // Number of registers
+static const uint8_t *twi_slave_ro;             // Read-only bitmask, or NULL
+static void (*twi_slave_callback)(uint8_t reg, uint8_t len);
+static volatile uint8_t twi_slave_busy;         // Addressed as slave
+static uint8_t twi_slave_ptr;                   // Current register
+static uint8_t twi_slave_first;                 // First register written
+static uint8_t twi_slave_count;                 // Bytes received, 0xff before register address
+
+
+// -- Local functions --------------------------------------
+/*
+ * Function: twi_clock_apply()
+ * Purpose:  Store bit rate into TWBR and prescaler bits of TWSR.
+ * Input:    clock Bit rate from twi_clock_div()
+ * Returns:  none
+ */
+static void twi_clock_apply(uint16_t clock)
+{
+    TWSR = (clock >> 8) - 1;
+    TWBR = clock & 0xff;
+}
+
+
+/*
+ * Function: twi_engine_start()
+ * Purpose:  Generate START for the oldest queued transaction. A STOP of
+ *           the previous transaction is sent first if requested.
+ * Input:    stop Send STOP before START
+ * Returns:  none
+ */
+static void twi_engine_start(uint8_t stop)
+{
+    twi_xfer_t *x = twi_queue[(twi_queue_tail + 1) & TWI_QUEUE_MASK];
+
+    twi_events++;
+    twi_clock_apply(x->clock ? x->clock : twi_clock_default);
+    twi_phase = (x->wlen != 0 || x->wlen2 != 0 || x->rlen == 0) ? TWI_WRITE : TWI_READ;
+    TWCR = TWI_CR_NEXT | (twi_cr_idle & (1<<TWEA)) | (1<<TWSTA) | (stop ? (1<<TWSTO) : 0);
+}
+
+
+/*
+ * Function: twi_engine_kick()
+ * Purpose:  Start the first queued transaction, or defer it while the
+ *           unit is addressed as slave.
+ * Returns:  none
+ */
+static void twi_engine_kick(void)
+{
+    if (twi_slave_busy || (twi_slave_regs && (TWCR & (1<<TWINT))))
+        twi_start_pending = 1;
+    else
+        twi_engine_start(0);
+}
+
+
+/*
+ * Function: twi_engine_finish()
+ * Purpose:  Complete current transaction, call its callback, and start
+ *           the next queued one or release the bus.
+ * Input:    x Current transaction
+ *           status Final status
+ * Returns:  none
+ */
+static void twi_engine_finish(twi_xfer_t *x, uint8_t status)
+{
+    twi_queue_tail = (twi_queue_tail + 1) & TWI_QUEUE_MASK;
+
+    x->status = status;
+    if (x->callback)
+        x->callback(x);
+
+    if (twi_queue_head != twi_queue_tail) {
+        twi_engine_start(1);
+    }
+    else {
+        twi_running = 0;
+        TWCR = (1<<TWINT) | (1<<TWSTO) | twi_cr_idle;
+    }
+}
+
+
+/*
+ * Function: twi_slave_step()
+ * Purpose:  Serve register file in slave mode according to TWI status
+ *           code. The first byte written by master selects the register,
+ *           following bytes are written or read with auto-increment.
+ * Input:    twi_status Status code 0x60 to 0xc8
+ * Returns:  none
+ */
+static void twi_slave_step(uint8_t twi_status)
+{
+    uint8_t data;
+
+    switch (twi_status) {
+    case 0x68:  // Arbitration lost as master, own SLA+W received
+        twi_start_pending = twi_running;
+        twi_stats.arb_lost++;
+        /* fall through */
+    case 0x60:  // Own SLA+W received, ACK returned
+        twi_slave_busy = 1;
+        twi_slave_count = 0xff;
+        break;
+
+    case 0x80:  // Data byte received, ACK returned
+    case 0x88:  // Data byte received, NACK returned
+        data = TWDR;
+        if (twi_slave_count == 0xff) {
+            twi_slave_ptr = (data < twi_slave_size) ? data : 0;
+            twi_slave_first = twi_slave_ptr;
+            twi_slave_count = 0;
+            break;
+        }
+        if (!twi_slave_ro || !(twi_slave_ro[twi_slave_ptr >> 3] & (1 << (twi_slave_ptr & 7))))
+            twi_slave_regs[twi_slave_ptr] = data;
+        if (++twi_slave_ptr >= twi_slave_size)
+            twi_slave_ptr = 0;
+        twi_slave_count++;
+        break;
+
+    case 0xb0:  // Arbitration lost as master, own SLA+R received
+        twi_start_pending = twi_running;
+        twi_stats.arb_lost++;
+        /* fall through */
+    case 0xa8:  // Own SLA+R received, ACK returned
+        twi_slave_busy = 1;
+        /* fall through */
+    case 0xb8:  // Data byte transmitted, ACK received
+        TWDR = twi_slave_regs[twi_slave_ptr];
+        if (++twi_slave_ptr >= twi_slave_size)
+            twi_slave_ptr = 0;
+        break;
+
+    case 0xa0:  // STOP or repeated START received
+        if (twi_slave_count != 0xff && twi_slave_count != 0 && twi_slave_callback)
+            twi_slave_callback(twi_slave_first, twi_slave_count);
+        /* fall through */
+    default:    // 0xc0, 0xc8: Last data byte transmitted
+        twi_slave_busy = 0;
+        twi_slave_count = 0xff;
+        if (twi_start_pending) {
+            twi_start_pending = 0;
+            twi_engine_start(0);
+            return;
+        }
+        break;
+    }
+
+    TWCR = (1<<TWINT) | twi_cr_idle;
+}
+
+
+/*
+ * Function: twi_engine_step()
+ * Purpose:  Advance current transaction according to TWI status code.
+ *           Called from TWI interrupt or by polling if interrupts are
+ *           disabled.
+ * Returns:  none
+ */
+static void twi_engine_step(void)
+{
+    twi_xfer_t *x = twi_queue[(twi_queue_tail + 1) & TWI_QUEUE_MASK];
+    uint8_t twi_status = TWSR & 0xf8;
+
+    twi_events++;
+    if (twi_recovering) {
+        // Stale event, twi_engine_abort() finishes the transaction
+        TWCR = (1<<TWEN);
+        return;
+    }
+    if (twi_status >= 0x60 && twi_status <= 0xc8) {
+        twi_slave_step(twi_status);
+        return;
+    }
+    if (!twi_running) {
+        // Bus error outside of master transaction
+        TWCR = (1<<TWINT) | (1<<TWSTO) | twi_cr_idle;
+        return;
+    }
+
+    switch (twi_status) {
+    case 0x08:  // START has been transmitted
+    case 0x10:  // Repeated START has been transmitted
+        twi_idx = 0;
+        TWDR = (x->addr<<1) | twi_phase;
+        TWCR = TWI_CR_NEXT;
+        return;
+
+    case 0x18:  // SLA+W has been transmitted and ACK received
+    case 0x28:  // Data byte has been transmitted and ACK received
+        if (twi_idx < x->wlen) {
+            TWDR = x->wbuf[twi_idx++];
+            TWCR = TWI_CR_NEXT;
+            return;
+        }
+        if (twi_idx - x->wlen < x->wlen2) {
+            TWDR = x->wbuf2[twi_idx++ - x->wlen];
+            TWCR = TWI_CR_NEXT;
+            return;
+        }
+        if (x->rlen != 0) {
+            // Repeated START, or STOP followed by START, of the read part
+            twi_phase = TWI_READ;
+            TWCR = TWI_CR_NEXT | (1<<TWSTA) | ((x->flags & TWI_XFER_STOP) ? (1<<TWSTO) : 0);
+            return;
+        }
+        twi_status = TWI_XFER_OK;
+        break;
+
+    case 0x40:  // SLA+R has been transmitted and ACK received
+        twi_idx = 0;
+        TWCR = (x->rlen > 1) ? (TWI_CR_NEXT | (1<<TWEA)) : TWI_CR_NEXT;
+        return;
+
+    case 0x50:  // Data byte has been received and ACK returned
+        x->rbuf[twi_idx++] = TWDR;
+        TWCR = (twi_idx + 1 < x->rlen) ? (TWI_CR_NEXT | (1<<TWEA)) : TWI_CR_NEXT;
+        return;
+
+    case 0x58:  // Data byte has been received and NACK returned
+        x->rbuf[twi_idx] = TWDR;
+        twi_status = TWI_XFER_OK;
+        break;
+
+    case 0x38:  // Arbitration lost in SLA+R/W or data bytes
+        twi_stats.arb_lost++;
+        if (x->retries < TWI_ARB_RETRIES) {
+            // Release the bus, retry after exponential backoff
+            x->retries++;
+            twi_stats.retries++;
+            twi_backoff = 1 << ((x->retries < 5) ? x->retries - 1 : 4);
+            TWCR = (1<<TWINT) | twi_cr_idle;
+            return;
+        }
+        twi_stats.arb_failed++;
+        break;
+
+    case 0x00:  // Bus error due to an illegal START or STOP
+        twi_status = TWI_ERR_BUS;
+        break;
+
+    default:    // NACK (0x20, 0x30, 0x48)
+        break;
+    }
+
+    twi_engine_finish(x, twi_status);
+}
+
+
+/*
+ * Function: twi_engine_abort()
+ * Purpose:  Abort current transaction after timeout, recover the bus,
+ *           and continue with the next queued one. The recovery runs
+ *           with interrupts as set by the caller.
+ * Returns:  none
+ */
+static void twi_engine_abort(void)
+{
+    twi_xfer_t *x = NULL;
+
+    /* Detach current transaction; twi_running stays set so that
+       twi_submit() only queues during recovery */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (twi_running && !twi_recovering) {
+            twi_recovering = 1;
+            TWCR = (1<<TWEN);
+            x = twi_queue[(twi_queue_tail + 1) & TWI_QUEUE_MASK];
+        }
+    }
+    if (x == NULL)
+        return;
+
+    /* Recovery takes up to a few ms, interrupts stay as they are */
+    twi_bus_recover();
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        twi_recovering = 0;
+        twi_engine_finish(x, TWI_ERR_TIMEOUT);
+    }
+}
+
+
+/*
+ * Function: twi_backoff_step()
+ * Purpose:  Count down backoff after lost arbitration and restart the
+ *           transaction when it expires.
+ * Returns:  none
+ */
+static void twi_backoff_step(void)
+{
+    if (twi_backoff != 0 && --twi_backoff == 0)
+        twi_engine_kick();
+}
+
+
+/*
+ * Function: twi_poll()
+ * Purpose:  Service the TWI by polling if interrupts are disabled.
+ * Returns:  none
+ */
+static void twi_poll(void)
+{
+    if (!(SREG & (1<<SREG_I)) && (TWCR & (1<<TWINT)) && (twi_running || twi_slave_regs))
+        twi_engine_step();
+}
+
+
+/*
+ * Function: twi_wait()
+ * Purpose:  Wait for completion of one transaction or of the whole
+ *           queue. Abort the transaction if there is no bus event
+ *           within TWI_TIMEOUT_US.
+ * Input:    x Transaction, or NULL to wait for empty queue
+ * Returns:  none
+ */
+static void twi_wait(twi_xfer_t *x)
+{
+    uint8_t events = twi_events;
+    uint16_t loops = TWI_TIMEOUT_LOOPS;
+    uint16_t backoff_loops = TWI_BACKOFF_LOOPS;
+
+    while (x ? (x->status == TWI_XFER_PENDING) : twi_running) {
+        twi_poll();
+        if (events != twi_events) {
+            events = twi_events;
+            loops = TWI_TIMEOUT_LOOPS;
+        }
+        else if (twi_backoff) {
+            // Waiting for retry is not a timeout
+            if (--backoff_loops == 0) {
+                ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                    twi_backoff_step();
+                }
+                backoff_loops = TWI_BACKOFF_LOOPS;
+            }
+        }
+        else if (--loops == 0) {
+            twi_engine_abort();
+            loops = TWI_TIMEOUT_LOOPS;
+        }
+    }
+}
+
+
+/*
+ * Function: twi_wait_int()
+ * Purpose:  Wait for TWINT flag of blocking functions. Recover the bus
+ *           if it does not come within TWI_TIMEOUT_US.
+ * Returns:  0 or TWI_ERR_TIMEOUT
+ */
+static uint8_t twi_wait_int(void)
+{
+    uint16_t loops = TWI_INT_LOOPS;
+
+    while ((TWCR & (1<<TWINT)) == 0) {
+        if (--loops == 0) {
+            twi_bus_recover();
+            return TWI_ERR_TIMEOUT;
+        }
+    }
+    return TWI_XFER_OK;
+}
 
 
 // -- Functions --------------------------------------------
@@ -24,21 +471,107 @@ void twi_init(void)
     TWI_PORT |= (1<<TWI_SDA_PIN) | (1<<TWI_SCL_PIN);
 
     /* Set SCL frequency */
-    TWSR &= ~((1<<TWPS1) | (1<<TWPS0));
-    TWBR = TWI_BIT_RATE_REG;
+    twi_clock_default = (1<<8) | TWI_BIT_RATE_REG;
+    twi_clock_apply(twi_clock_default);
+}
+
+
+/*
+ * Function: twi_clock_div()
+ * Purpose:  Calculate TWBR and TWPS values for SCL frequency.
+ * Input:    hz Required SCL frequency in Hz
+ * Returns:  (TWPS+1)<<8 | TWBR, never 0
+ */
+uint16_t twi_clock_div(uint32_t hz)
+{
+    uint32_t div;
+    uint8_t ps;
+
+    if (hz == 0)
+        hz = 1;
+
+    /* TWBR*4^TWPS = (F_CPU/hz - 16)/2, rounded up so that the rate is
+       not higher than requested */
+    div = (F_CPU + hz - 1) / hz;
+    div = (div > 16) ? (div - 16 + 1) / 2 : 0;
+    for (ps = 0; ps < 3 && div > 255; ps++)
+        div = (div + 3) / 4;
+    if (div > 255)
+        div = 255;
+
+    return ((uint16_t)(ps + 1) << 8) | div;
+}
+
+
+/*
+ * Function: twi_set_clock()
+ * Purpose:  Set default SCL frequency.
+ * Input:    hz Required SCL frequency in Hz
+ * Returns:  Actual SCL frequency in Hz
+ */
+uint32_t twi_set_clock(uint32_t hz)
+{
+    uint16_t clock = twi_clock_div(hz);
+
+    twi_clock_default = clock;
+    if (!twi_running)
+        twi_clock_apply(clock);
+
+    return twi_clock_rate(clock);
+}
+
+
+/*
+ * Function: twi_clock_rate()
+ * Purpose:  Calculate SCL frequency of bit rate.
+ * Input:    clock Bit rate from twi_clock_div()
+ * Returns:  SCL frequency in Hz
+ */
+uint32_t twi_clock_rate(uint16_t clock)
+{
+    uint8_t ps = (clock >> 8) - 1;
+
+    return F_CPU / (16 + ((uint32_t)(clock & 0xff) << (2*ps + 1)));
 }
 
 
 /*
  * Function: twi_start()
  * Purpose:  Start communication on I2C/TWI bus.
- * Returns:  none
+ * Returns:  Status code, 0 if START has been transmitted
  */
-void twi_start(void)
+uint8_t twi_start(void)
 {
+    uint8_t twi_status;
+
+    /* Wait for queued transactions and take the bus from the queue;
+       twi_submit() only queues until twi_stop() */
+    while (!twi_owned) {
+        twi_wait(NULL);
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            if (!twi_running)
+                twi_owned = 1;
+        }
+    }
+    twi_clock_apply(twi_clock_default);
+
     /* Send Start condition */
     TWCR = (1<<TWINT) | (1<<TWSTA) | (1<<TWEN);
-    while ((TWCR & (1<<TWINT)) == 0);
+    twi_status = twi_wait_int();
+    if (twi_status == TWI_XFER_OK) {
+        /* Status Code:
+             - 0x08: START has been transmitted
+             - 0x10: Repeated START has been transmitted
+        */
+        twi_status = TWSR & 0xf8;
+        if (twi_status == 0x08 || twi_status == 0x10)
+            twi_status = TWI_XFER_OK;
+        else if (twi_status == 0x00)
+            twi_status = TWI_ERR_BUS;
+    }
+
+    twi_last_status = twi_status;
+    return twi_status;
 }
 
 
@@ -46,7 +579,7 @@ void twi_start(void)
  * Function: twi_write()
  * Purpose:  Write one byte to the I2C/TWI bus.
  * Input:    data Byte to be transmitted
- * Returns:  ACK/NACK received value
+ * Returns:  Status code, 0 if ACK has been received
  */
 uint8_t twi_write(uint8_t data)
 {
@@ -55,20 +588,24 @@ uint8_t twi_write(uint8_t data)
     /* Send SLA+R, SLA+W, or data byte on I2C/TWI bus */
     TWDR = data;
     TWCR = (1<<TWINT) | (1<<TWEN);
-    while ((TWCR & (1<<TWINT)) == 0);
-
-    /* Check value of TWI status register */
-    twi_status = TWSR & 0xf8;
-
-    /* Status Code:
-         - 0x18: SLA+W has been transmitted and ACK received
-         - 0x28: Data byte has been transmitted and ACK has been received
-         - 0x40: SLA+R has been transmitted and ACK received
-    */
-    if (twi_status == 0x18 || twi_status == 0x28 || twi_status == 0x40)
-        return 0;   /* ACK received */
-    else
-        return 1;   /* NACK received */
+    twi_status = twi_wait_int();
+    if (twi_status == TWI_XFER_OK) {
+        /* Check value of TWI status register */
+        twi_status = TWSR & 0xf8;
+
+        /* Status Code:
+             - 0x18: SLA+W has been transmitted and ACK received
+             - 0x28: Data byte has been transmitted and ACK has been received
+             - 0x40: SLA+R has been transmitted and ACK received
+        */
+        if (twi_status == 0x18 || twi_status == 0x28 || twi_status == 0x40)
+            twi_status = TWI_XFER_OK;   /* ACK received */
+        else if (twi_status == 0x00)
+            twi_status = TWI_ERR_BUS;
+    }
+
+    twi_last_status = twi_status;
+    return twi_status;
 }
 
 
@@ -81,16 +618,41 @@ uint8_t twi_write(uint8_t data)
  */
 uint8_t twi_read(uint8_t ack)
 {
+    uint8_t twi_status;
+
     if (ack == TWI_ACK)
         TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWEA);
     else
         TWCR = (1<<TWINT) | (1<<TWEN);
-    while ((TWCR & (1<<TWINT)) == 0);
+    twi_status = twi_wait_int();
+    if (twi_status == TWI_XFER_OK) {
+        /* Status Code:
+             - 0x50: Data byte has been received and ACK returned
+             - 0x58: Data byte has been received and NACK returned
+        */
+        twi_status = TWSR & 0xf8;
+        if (twi_status == 0x50 || twi_status == 0x58)
+            twi_status = TWI_XFER_OK;
+        else if (twi_status == 0x00)
+            twi_status = TWI_ERR_BUS;
+    }
 
+    twi_last_status = twi_status;
     return (TWDR);
 }
 
 
+/*
+ * Function: twi_get_status()
+ * Purpose:  Get status of the last blocking function.
+ * Returns:  Status code, 0 on success
+ */
+uint8_t twi_get_status(void)
+{
+    return twi_last_status;
+}
+
+
 /*
  * Function: twi_stop()
  * Purpose:  Generates Stop condition on I2C/TWI bus.
@@ -98,7 +660,17 @@ uint8_t twi_read(uint8_t ack)
  */
 void twi_stop(void)
 {
-    TWCR = (1<<TWINT) | (1<<TWSTO) | (1<<TWEN);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        twi_owned = 0;
+        if (twi_queue_head != twi_queue_tail && !twi_running) {
+            /* Transactions queued meanwhile, STOP followed by START */
+            twi_running = 1;
+            twi_engine_start(1);
+        }
+        else {
+            TWCR = (1<<TWINT) | (1<<TWSTO) | twi_cr_idle;
+        }
+    }
 }
 
 
@@ -106,14 +678,15 @@ void twi_stop(void)
  * Function: twi_test_address()
  * Purpose:  Test presence of one I2C device on the bus.
  * Input:    addr Slave address
- * Returns:  ACK/NACK received value
+ * Returns:  Status code, 0 if ACK has been received
  */
 uint8_t twi_test_address(uint8_t addr)
 {
     uint8_t ack;  // ACK response from Slave
 
-    twi_start();
-    ack = twi_write((addr<<1) | TWI_WRITE);
+    ack = twi_start();
+    if (ack == TWI_XFER_OK)
+        ack = twi_write((addr<<1) | TWI_WRITE);
     twi_stop();
 
     return ack;
@@ -127,32 +700,520 @@ uint8_t twi_test_address(uint8_t addr)
  *           memaddr Starting address
  *           buf Buffer to be read into
  *           nbytes Number of bytes
- * Returns:  None
- */
-void twi_readfrom_mem_into(uint8_t addr, uint8_t memaddr, volatile uint8_t *buf, uint8_t nbytes)
-{
-    twi_start();
-    if (twi_write((addr<<1) | TWI_WRITE) == 0)
-    {
-        // Set starting address
-        twi_write(memaddr);
-        twi_stop();
-
-        // Read data into the buffer
-        twi_start();
-        twi_write((addr<<1) | TWI_READ);
-        if (nbytes >= 2)
-        {
-            for (uint8_t i=0; i<(nbytes-1); i++)
-            {
-                *buf++ = twi_read(TWI_ACK);
-            }
+ * Returns:  Status code of the transaction
+ */
+uint8_t twi_readfrom_mem_into(uint8_t addr, uint8_t memaddr, volatile uint8_t *buf, uint8_t nbytes)
+{
+    twi_xfer_t x = {
+        .addr = addr,
+        .wbuf = &memaddr,
+        .wlen = 1,
+        .rbuf = buf,
+        .rlen = nbytes,
+    };
+
+    return twi_transfer(&x);
+}
+
+
+/*
+ * Function: twi_readfrom_mem16_into()
+ * Purpose:  Read into buf from the peripheral starting from the 16-bit
+ *           memory address.
+ * Input:    addr Slave address
+ *           memaddr Starting address, sent MSB first
+ *           buf Buffer to be read into
+ *           nbytes Number of bytes
+ * Returns:  Status code of the transaction
+ */
+uint8_t twi_readfrom_mem16_into(uint8_t addr, uint16_t memaddr, volatile uint8_t *buf, uint8_t nbytes)
+{
+    uint8_t mem[2] = {memaddr >> 8, memaddr & 0xff};
+    twi_xfer_t x = {
+        .addr = addr,
+        .wbuf = mem,
+        .wlen = 2,
+        .rbuf = buf,
+        .rlen = nbytes,
+    };
+
+    return twi_transfer(&x);
+}
+
+
+/*
+ * Function: twi_writeto_mem()
+ * Purpose:  Write buf to the peripheral starting from the memory address.
+ * Input:    addr Slave address
+ *           memaddr Starting address
+ *           buf Data to be written
+ *           nbytes Number of bytes
+ * Returns:  Status code of the transaction
+ */
+uint8_t twi_writeto_mem(uint8_t addr, uint8_t memaddr, const uint8_t *buf, uint8_t nbytes)
+{
+    return twi_writevto(addr, &memaddr, 1, buf, nbytes);
+}
+
+
+/*
+ * Function: twi_writeto_mem16()
+ * Purpose:  Write buf to the peripheral starting from the 16-bit memory
+ *           address.
+ * Input:    addr Slave address
+ *           memaddr Starting address, sent MSB first
+ *           buf Data to be written
+ *           nbytes Number of bytes
+ * Returns:  Status code of the transaction
+ */
+uint8_t twi_writeto_mem16(uint8_t addr, uint16_t memaddr, const uint8_t *buf, uint8_t nbytes)
+{
+    uint8_t mem[2] = {memaddr >> 8, memaddr & 0xff};
+
+    return twi_writevto(addr, mem, 2, buf, nbytes);
+}
+
+
+/*
+ * Function: twi_writevto()
+ * Purpose:  Write two buffers to the peripheral in one transaction.
+ * Input:    addr Slave address
+ *           buf1, len1 First buffer, e.g. memory address
+ *           buf2, len2 Second buffer, e.g. payload
+ * Returns:  Status code of the transaction
+ */
+uint8_t twi_writevto(uint8_t addr, const uint8_t *buf1, uint8_t len1, const uint8_t *buf2, uint8_t len2)
+{
+    twi_xfer_t x = {
+        .addr = addr,
+        .wbuf = buf1,
+        .wlen = len1,
+        .wbuf2 = buf2,
+        .wlen2 = len2,
+    };
+
+    return twi_transfer(&x);
+}
+
+
+/*
+ * Function: twi_cache_init()
+ * Purpose:  Initialize register cache.
+ * Input:    c Cache structure
+ *           addr Slave address
+ *           first, count Range of cached registers
+ *           shadow, valid Buffers of cached values and valid bits
+ * Returns:  none
+ */
+void twi_cache_init(twi_cache_t *c, uint8_t addr, uint8_t first, uint8_t count,
+                    uint8_t *shadow, uint8_t *valid)
+{
+    c->addr = addr;
+    c->first = first;
+    c->count = count;
+    c->shadow = shadow;
+    c->valid = valid;
+    c->hits = 0;
+    c->skipped = 0;
+    c->bus_bytes = 0;
+    c->saved_bytes = 0;
+    twi_cache_invalidate(c);
+}
+
+
+/*
+ * Function: twi_cache_load()
+ * Purpose:  Read all cached registers in one transaction.
+ * Input:    c Cache structure
+ * Returns:  Status code of the transaction
+ */
+uint8_t twi_cache_load(twi_cache_t *c)
+{
+    uint8_t twi_status;
+    uint8_t i;
+
+    twi_status = twi_readfrom_mem_into(c->addr, c->first, c->shadow, c->count);
+    c->bus_bytes += 3 + c->count;   /* SLA+W, register, SLA+R, data */
+    if (twi_status == TWI_XFER_OK) {
+        for (i = 0; i < (c->count + 7) / 8; i++)
+            c->valid[i] = 0xff;
+    }
+    return twi_status;
+}
+
+
+/*
+ * Function: twi_cache_invalidate()
+ * Purpose:  Mark all registers invalid.
+ * Input:    c Cache structure
+ * Returns:  none
+ */
+void twi_cache_invalidate(twi_cache_t *c)
+{
+    uint8_t i;
+
+    for (i = 0; i < (c->count + 7) / 8; i++)
+        c->valid[i] = 0;
+}
+
+
+/*
+ * Function: twi_cache_read()
+ * Purpose:  Read register from RAM if valid, otherwise from the bus.
+ * Input:    c Cache structure
+ *           reg Register address
+ *           value Read value
+ * Returns:  Status code
+ */
+uint8_t twi_cache_read(twi_cache_t *c, uint8_t reg, uint8_t *value)
+{
+    uint8_t idx = reg - c->first;
+    uint8_t twi_status;
+
+    if (idx < c->count && (c->valid[idx >> 3] & (1 << (idx & 7)))) {
+        *value = c->shadow[idx];
+        c->hits++;
+        c->saved_bytes += 4;
+        return TWI_XFER_OK;
+    }
+
+    twi_status = twi_readfrom_mem_into(c->addr, reg, value, 1);
+    c->bus_bytes += 4;
+    if (twi_status == TWI_XFER_OK && idx < c->count) {
+        c->shadow[idx] = *value;
+        c->valid[idx >> 3] |= 1 << (idx & 7);
+    }
+    return twi_status;
+}
+
+
+/*
+ * Function: twi_cache_write()
+ * Purpose:  Write register unless the cached value is the same.
+ * Input:    c Cache structure
+ *           reg Register address
+ *           value Value to be written
+ * Returns:  Status code
+ */
+uint8_t twi_cache_write(twi_cache_t *c, uint8_t reg, uint8_t value)
+{
+    uint8_t idx = reg - c->first;
+    uint8_t twi_status;
+
+    if (idx < c->count && (c->valid[idx >> 3] & (1 << (idx & 7))) &&
+        c->shadow[idx] == value) {
+        c->skipped++;
+        c->saved_bytes += 3;
+        return TWI_XFER_OK;
+    }
+
+    twi_status = twi_writeto_mem(c->addr, reg, &value, 1);
+    c->bus_bytes += 3;
+    if (idx < c->count) {
+        /* Value of the register is unknown if the write failed */
+        c->shadow[idx] = value;
+        if (twi_status == TWI_XFER_OK)
+            c->valid[idx >> 3] |= 1 << (idx & 7);
+        else
+            c->valid[idx >> 3] &= ~(1 << (idx & 7));
+    }
+    return twi_status;
+}
+
+
+/*
+ * Function: twi_cache_update()
+ * Purpose:  Change masked bits of register, read it only if not valid.
+ * Input:    c Cache structure
+ *           reg Register address
+ *           mask Bits to be changed
+ *           value New value of the bits
+ * Returns:  Status code
+ */
+uint8_t twi_cache_update(twi_cache_t *c, uint8_t reg, uint8_t mask, uint8_t value)
+{
+    uint8_t old;
+    uint8_t twi_status;
+
+    twi_status = twi_cache_read(c, reg, &old);
+    if (twi_status != TWI_XFER_OK)
+        return twi_status;
+
+    return twi_cache_write(c, reg, (old & ~mask) | (value & mask));
+}
+
+
+/*
+ * Function: twi_bus_recover()
+ * Purpose:  Release the bus held by a slave by 9 SCL pulses and STOP.
+ * Returns:  0 if both lines are high, TWI_ERR_BUS otherwise
+ */
+uint8_t twi_bus_recover(void)
+{
+    uint8_t i;
+    uint8_t loops;
+
+    /* Disable TWI unit; lines are driven low by DDR only (open drain) */
+    TWCR = 0;
+    DDR(TWI_PORT) &= ~((1<<TWI_SDA_PIN) | (1<<TWI_SCL_PIN));
+    TWI_PORT |= (1<<TWI_SDA_PIN) | (1<<TWI_SCL_PIN);
+
+    /* Clock out the byte a slave may still be sending */
+    for (i = 0; i < 9 && !(PIN(TWI_PORT) & (1<<TWI_SDA_PIN)); i++) {
+        TWI_PORT &= ~(1<<TWI_SCL_PIN);
+        DDR(TWI_PORT) |= (1<<TWI_SCL_PIN);
+        _delay_us(5);
+        DDR(TWI_PORT) &= ~(1<<TWI_SCL_PIN);
+        TWI_PORT |= (1<<TWI_SCL_PIN);
+        for (loops = 255; loops && !(PIN(TWI_PORT) & (1<<TWI_SCL_PIN)); loops--)
+            _delay_us(1);   /* clock stretching */
+        _delay_us(5);
+    }
+
+    /* STOP: SDA rises while SCL is high */
+    TWI_PORT &= ~((1<<TWI_SDA_PIN) | (1<<TWI_SCL_PIN));
+    DDR(TWI_PORT) |= (1<<TWI_SCL_PIN);
+    DDR(TWI_PORT) |= (1<<TWI_SDA_PIN);
+    _delay_us(5);
+    DDR(TWI_PORT) &= ~(1<<TWI_SCL_PIN);
+    TWI_PORT |= (1<<TWI_SCL_PIN);
+    _delay_us(5);
+    DDR(TWI_PORT) &= ~(1<<TWI_SDA_PIN);
+    TWI_PORT |= (1<<TWI_SDA_PIN);
+    _delay_us(5);
+
+    /* Enable TWI unit again */
+    TWCR = twi_cr_idle;
+
+    if ((PIN(TWI_PORT) & ((1<<TWI_SDA_PIN) | (1<<TWI_SCL_PIN))) !=
+        ((1<<TWI_SDA_PIN) | (1<<TWI_SCL_PIN)))
+        return TWI_ERR_BUS;
+    return TWI_XFER_OK;
+}
+
+
+/*
+ * Function: twi_submit()
+ * Purpose:  Queue transaction to be executed by the TWI interrupt.
+ * Input:    x Transaction descriptor
+ * Returns:  1 if queued, 0 if the queue is full
+ */
+uint8_t twi_submit(twi_xfer_t *x)
+{
+    uint8_t tmphead;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        tmphead = (twi_queue_head + 1) & TWI_QUEUE_MASK;
+        if (tmphead == twi_queue_tail)
+            return 0;
+
+        x->status = TWI_XFER_PENDING;
+        x->retries = 0;
+        twi_queue[tmphead] = x;
+        twi_queue_head = tmphead;
+
+        /* Bus owned by blocking functions is released by twi_stop() */
+        if (!twi_running && !twi_owned) {
+            twi_running = 1;
+            twi_engine_kick();
         }
-        *buf = twi_read(TWI_NACK);
-        twi_stop();
     }
-    else
-    {
-        twi_stop();
+    return 1;
+}
+
+
+/*
+ * Function: twi_transfer()
+ * Purpose:  Queue transaction and wait for its completion.
+ * Input:    x Transaction descriptor
+ * Returns:  Final status of the transaction, TWI_ERR_BUS if called
+ *           with interrupts disabled while the bus is owned by the
+ *           blocking functions
+ */
+uint8_t twi_transfer(twi_xfer_t *x)
+{
+    /* Interrupted twi_start()...twi_stop() would never release the bus */
+    if (twi_owned && !(SREG & (1<<SREG_I))) {
+        x->status = TWI_ERR_BUS;
+        return x->status;
+    }
+
+    while (!twi_submit(x))
+        twi_wait(NULL);
+    twi_wait(x);
+
+    return x->status;
+}
+
+
+/*
+ * Function: twi_busy()
+ * Purpose:  Test if the transaction queue is being processed.
+ * Returns:  1 if a transaction is in progress, 0 otherwise
+ */
+uint8_t twi_busy(void)
+{
+    return twi_running;
+}
+
+
+/*
+ * Function: twi_scan()
+ * Purpose:  Find all devices on the bus at TWI_SCAN_HZ.
+ * Input:    bitmap Array of 16 bytes to be filled in
+ * Returns:  Number of devices found
+ */
+uint8_t twi_scan(uint8_t bitmap[16])
+{
+    twi_xfer_t x = {
+        .clock = twi_clock_div(TWI_SCAN_HZ),
+    };
+    uint8_t n_devices = 0;
+    uint8_t i;
+
+    for (i = 0; i < 16; i++)
+        bitmap[i] = 0;
+
+    /* Address only, skip reserved addresses */
+    for (x.addr = 0x08; x.addr < 0x78; x.addr++) {
+        if (twi_transfer(&x) == TWI_XFER_OK) {
+            bitmap[x.addr >> 3] |= 1 << (x.addr & 7);
+            n_devices++;
+        }
+    }
+    return n_devices;
+}
+
+
+/*
+ * Function: twi_identify()
+ * Purpose:  Identify device by its chip ID register.
+ * Input:    addr Slave address
+ * Returns:  Name in program memory or NULL
+ */
+const char *twi_identify(uint8_t addr)
+{
+    uint8_t reg;
+    uint8_t last_reg = 0;
+    uint8_t id = 0;
+    uint8_t valid = 0;
+    uint8_t i;
+    twi_xfer_t x = {
+        .addr = addr,
+        .wbuf = &reg,
+        .wlen = 1,
+        .rbuf = &id,
+        .rlen = 1,
+        .clock = twi_clock_div(TWI_SCAN_HZ),
+    };
+
+    for (i = 0; i < sizeof(twi_ids) / sizeof(twi_ids[0]); i++) {
+        if (pgm_read_byte(&twi_ids[i].addr) != addr)
+            continue;
+
+        /* Read each ID register only once */
+        reg = pgm_read_byte(&twi_ids[i].reg);
+        if (!valid || reg != last_reg) {
+            if (twi_transfer(&x) != TWI_XFER_OK)
+                return NULL;
+            last_reg = reg;
+            valid = 1;
+        }
+        if (id == pgm_read_byte(&twi_ids[i].id))
+            return (const char *)pgm_read_word(&twi_ids[i].name);
+    }
+    return NULL;
+}
+
+
+/*
+ * Function: twi_slave_init()
+ * Purpose:  Serve register file as slave device at the address.
+ * Input:    addr Own 7-bit slave address
+ *           regs Register file, or NULL to disable slave mode
+ *           size Number of registers
+ *           ro_mask Bitmask of read-only registers, or NULL
+ *           callback Called after master has written registers, or NULL
+ * Returns:  none
+ */
+void twi_slave_init(uint8_t addr, volatile uint8_t *regs, uint8_t size,
+                    const uint8_t *ro_mask, void (*callback)(uint8_t reg, uint8_t len))
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        twi_slave_regs = regs;
+        twi_slave_size = size;
+        twi_slave_ro = ro_mask;
+        twi_slave_callback = callback;
+        twi_slave_ptr = 0;
+        twi_slave_count = 0xff;
+        twi_slave_busy = 0;
+
+        TWAR = addr << 1;
+        twi_cr_idle = regs ? ((1<<TWEN) | (1<<TWEA) | (1<<TWIE)) : (1<<TWEN);
+        if (!twi_running)
+            TWCR = twi_cr_idle;
+    }
+}
+
+
+/*
+ * Function: twi_tick()
+ * Purpose:  Count down arbitration backoff. Abort transaction in
+ *           progress if there was no bus event since the previous call.
+ * Returns:  none
+ */
+void twi_tick(void)
+{
+    static uint8_t events;
+
+    if (twi_backoff) {
+        twi_backoff_step();
     }
+    else if (twi_running && events == twi_events) {
+        /* Called from timer interrupt, do not block other interrupts
+           during bus recovery */
+        NONATOMIC_BLOCK(NONATOMIC_RESTORESTATE) {
+            twi_engine_abort();
+        }
+    }
+    events = twi_events;
+}
+
+
+/*
+ * Function: twi_stats_get()
+ * Purpose:  Copy multi-master counters.
+ * Input:    stats Structure to be filled in
+ * Returns:  none
+ */
+void twi_stats_get(twi_stats_t *stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *stats = twi_stats;
+    }
+}
+
+
+/*
+ * Function: twi_stats_clear()
+ * Purpose:  Clear multi-master counters.
+ * Returns:  none
+ */
+void twi_stats_clear(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        twi_stats.arb_lost = 0;
+        twi_stats.retries = 0;
+        twi_stats.arb_failed = 0;
+    }
+}
+
+
+/*
+ * Function: TWI interrupt
+ * Purpose:  Advance queued transaction after each bus event.
+ */
+ISR(TWI_vect)
+{
+    twi_engine_step();
 }
@@ -19,13 +19,24 @@
  * This library defines functions for the TWI (I2C) communication between
  * AVR and Slave device(s). Functions use internal TWI module of AVR.
  *
- * @note Only Master transmitting and Master receiving modes are implemented. Based on Microchip Atmel ATmega16 and ATmega328P manuals.
+ * Besides the blocking primitives, transactions (write, read, or write
+ * followed by read) can be queued by twi_submit() and are then executed
+ * in the background by the TWI interrupt. The same interrupt can serve
+ * a register file in slave mode, see twi_slave_init().
+ *
+ * Do not mix the blocking primitives (twi_start() ... twi_stop()) in the
+ * main loop with twi_transfer() or its wrappers called from an interrupt
+ * handler: such a transfer cannot wait for twi_stop() and fails with
+ * TWI_ERR_BUS. Use twi_submit() from interrupts instead.
+ *
+ * @note Based on Microchip Atmel ATmega16 and ATmega328P manuals.
  * @copyright (c) 2018-2025 Tomas Fryza, MIT license
  * @{
  */
 
 // -- Includes ---------------------------------------------
  #include <avr/io.h>
+ #include <avr/pgmspace.h>
 
 
 // -- Defines ----------------------------------------------
@@ -35,7 +46,7 @@
 #ifndef F_CPU
 #define F_CPU 16000000 /**< @brief CPU frequency in Hz required TWI_BIT_RATE_REG */
 #endif
-#define F_SCL 100000 /**< @brief I2C/TWI bit rate. Must be greater than 31000 */
+#define F_SCL 100000 /**< @brief Default I2C/TWI bit rate, see twi_set_clock() for other rates */
 #define TWI_BIT_RATE_REG ((F_CPU/F_SCL - 16) / 2) /**< @brief TWI bit rate register value */
 
 
@@ -58,6 +69,101 @@
 #define PIN(_x) (*(&_x - 2)) /**< @brief Address of input register of port _x */
 
 
+/**
+ * @name Transaction queue
+ */
+#ifndef TWI_QUEUE_SIZE
+#define TWI_QUEUE_SIZE 4 /**< @brief Number of queued transactions, must be power of 2 */
+#endif
+#define TWI_XFER_OK 0x00 /**< @brief Transaction completed */
+#define TWI_XFER_PENDING 0xff /**< @brief Transaction queued or in progress */
+#define TWI_ERR_BUS 0x01 /**< @brief Illegal START or STOP detected (status 0x00) */
+#define TWI_ERR_TIMEOUT 0x02 /**< @brief No bus event within TWI_TIMEOUT_US, bus has been recovered */
+#define TWI_XFER_STOP 0x01 /**< @brief Flag: STOP and START instead of repeated START before the read part */
+
+
+/**
+ * @name Bus scan
+ */
+#ifndef TWI_SCAN_HZ
+#define TWI_SCAN_HZ 400000 /**< @brief SCL frequency of twi_scan() and twi_identify() */
+#endif
+
+
+/**
+ * @name Multi-master arbitration
+ */
+#ifndef TWI_ARB_RETRIES
+#define TWI_ARB_RETRIES 8 /**< @brief Retries of a queued transaction after lost arbitration (0x38) */
+#endif
+#ifndef TWI_BACKOFF_US
+#define TWI_BACKOFF_US 100 /**< @brief Backoff unit while waiting in twi_transfer() and blocking wrappers */
+#endif
+
+
+/**
+ * @name Timeout
+ */
+#ifndef TWI_TIMEOUT_US
+#define TWI_TIMEOUT_US 5000 /**< @brief Minimum wait for one bus event in microseconds; counted by wait loops, the actual timeout is up to about 1.5 times longer, more if interrupts take CPU time */
+#endif
+
+
+// -- Types ------------------------------------------------
+/**
+ * @brief Descriptor of one queued transaction.
+ *
+ * wlen bytes of wbuf and wlen2 bytes of wbuf2 are written, followed by
+ * a repeated START and reading of rlen bytes. Either part can be empty;
+ * if all lengths are zero, only the address is sent. The descriptor and the buffers must stay valid until
+ * status is other than TWI_XFER_PENDING.
+ */
+typedef struct twi_xfer {
+    uint8_t addr;                /**< @brief 7-bit slave address */
+    const uint8_t *wbuf;         /**< @brief Bytes to be written */
+    uint8_t wlen;                /**< @brief Number of bytes to be written */
+    const uint8_t *wbuf2;        /**< @brief Bytes to be written after wbuf, e.g. payload */
+    uint8_t wlen2;               /**< @brief Number of bytes in wbuf2 */
+    volatile uint8_t *rbuf;      /**< @brief Buffer to be read into */
+    uint8_t rlen;                /**< @brief Number of bytes to be read */
+    uint16_t clock;              /**< @brief Bit rate from twi_clock_div(), or 0 for the default rate */
+    uint8_t flags;               /**< @brief TWI_XFER_STOP or 0 */
+    uint8_t retries;             /**< @brief Retries after lost arbitration, set by the engine */
+    void (*callback)(struct twi_xfer *x); /**< @brief Called from the interrupt when done, or NULL */
+    volatile uint8_t status;     /**< @brief TWI_XFER_OK, TWI_XFER_PENDING, TWI_ERR_xxx, or TWSR status code of the failed step */
+} twi_xfer_t;
+
+
+/**
+ * @brief Multi-master counters, see twi_stats_get().
+ */
+typedef struct {
+    uint16_t arb_lost;           /**< @brief Arbitration lost (0x38, 0x68, 0xb0) */
+    uint16_t retries;            /**< @brief Queued transactions restarted after backoff */
+    uint16_t arb_failed;         /**< @brief Transactions failed after TWI_ARB_RETRIES retries */
+} twi_stats_t;
+
+
+/**
+ * @brief Write-through cache of a range of device registers.
+ *
+ * Reads of valid registers are served from RAM, writes of unchanged
+ * values are skipped. Cache only registers which are changed by the
+ * application alone, such as configuration registers.
+ */
+typedef struct {
+    uint8_t addr;                /**< @brief 7-bit slave address */
+    uint8_t first;               /**< @brief First cached register */
+    uint8_t count;               /**< @brief Number of cached registers */
+    uint8_t *shadow;             /**< @brief Copy of count registers */
+    uint8_t *valid;              /**< @brief Bitmap of valid registers, (count+7)/8 bytes */
+    uint16_t hits;               /**< @brief Reads served from RAM */
+    uint16_t skipped;            /**< @brief Writes not sent because the value is unchanged */
+    uint16_t bus_bytes;          /**< @brief Bytes transferred on the bus, including SLA */
+    uint16_t saved_bytes;        /**< @brief Bytes which would be transferred without cache */
+} twi_cache_t;
+
+
 // -- Function prototypes ----------------------------------
 /**
  * @brief  Initialize TWI unit, enable internal pull-ups, and set SCL frequency.
@@ -71,19 +177,57 @@
 void twi_init(void);
 
 
+/**
+ * @brief  Set default SCL frequency used by blocking functions and by
+ *         transactions without their own clock.
+ * @param  hz Required SCL frequency in Hz, F_CPU/16 at most
+ * @return Actual SCL frequency in Hz, the closest one not above hz
+ * @par    Implementation notes:
+ *           - fscl = fcpu/(16 + 2*TWBR*4^TWPS), the smallest prescaler
+ *             TWPS which fits is used to get the best resolution
+ *           - At 16 MHz, 100 kHz, 400 kHz, and 1 MHz are exact
+ */
+uint32_t twi_set_clock(uint32_t hz);
+
+
+/**
+ * @brief  Calculate TWBR and TWPS values for SCL frequency.
+ * @param  hz Required SCL frequency in Hz
+ * @return Bit rate to be stored in twi_xfer_t.clock
+ */
+uint16_t twi_clock_div(uint32_t hz);
+
+
+/**
+ * @brief  Calculate SCL frequency of bit rate.
+ * @param  clock Bit rate from twi_clock_div()
+ * @return SCL frequency in Hz
+ */
+uint32_t twi_clock_rate(uint16_t clock);
+
+
 /**
  * @brief  Start communication on I2C/TWI bus.
- * @return none
+ * @return Status code
+ * @retval 0 - START or repeated START has been transmitted
+ * @retval TWI_ERR_TIMEOUT - Bus is held by other device, bus has been recovered
+ * @retval other - TWSR status code or TWI_ERR_BUS
+ * @note   Queued transactions are completed first. The bus then belongs
+ *         to the blocking functions until twi_stop(); transactions
+ *         submitted meanwhile, e.g. from an interrupt, are started by
+ *         twi_stop().
  */
-void twi_start(void);
+uint8_t twi_start(void);
 
 
 /**
  * @brief  Write one byte to the I2C/TWI bus.
  * @param  data Byte to be transmitted
- * @return ACK/NACK received value
+ * @return Status code
  * @retval 0 - ACK has been received
- * @retval 1 - NACK has been received
+ * @retval 0x20, 0x30, 0x48 - NACK has been received after SLA+W, data, or SLA+R
+ * @retval 0x38 - Arbitration has been lost
+ * @retval TWI_ERR_TIMEOUT - Bus is held by other device, bus has been recovered
  * @note   Function returns 0 if 0x18, 0x28, or 0x40 status code is detected\n
  *           - 0x18: SLA+W has been transmitted and ACK has been received\n
  *           - 0x28: Data byte has been transmitted and ACK has been received\n
@@ -96,14 +240,22 @@ uint8_t twi_write(uint8_t data);
  * @brief  Read one byte from the I2C/TWI bus and acknowledge
  *         it by ACK or NACK.
  * @param  ack - ACK/NACK value to be transmitted
- * @return Received data byte
+ * @return Received data byte, see twi_get_status() for errors
  */
 uint8_t twi_read(uint8_t ack);
 
 
+/**
+ * @brief  Get status of the last twi_start(), twi_write(), or twi_read().
+ * @return Status code, 0 on success
+ */
+uint8_t twi_get_status(void);
+
+
 /**
  * @brief  Generates Stop condition on I2C/TWI bus.
  * @return none
+ * @note   Releases the bus to the transaction queue, see twi_start().
  */
 void twi_stop(void);
 
@@ -111,22 +263,272 @@ void twi_stop(void);
 /**
  * @brief  Test presence of one I2C device on the bus.
  * @param  addr Slave address
- * @return ACK/NACK received value
+ * @return Status code
  * @retval 0 - ACK has been received
- * @retval 1 - NACK has been received
+ * @retval other - NACK (0x20) or error, see twi_write()
  */
 uint8_t twi_test_address(uint8_t addr);
 
 
 /**
  * @brief  Read into buf from the peripheral, starting from the memory address.
+ *
+ * The memory address is written and the data are read after a repeated
+ * START, so that no other master can access the device in between.
+ *
  * @param  addr Slave address
  * @param  memaddr Starting address
  * @param  buf Buffer to be read into
  * @param  nbytes Number of bytes
+ * @return Status code of the transaction, TWI_XFER_OK on success,
+ *         TWI_ERR_BUS from an interrupt handler while the bus is owned
+ *         by the blocking functions, see twi_transfer()
+ */
+uint8_t twi_readfrom_mem_into(uint8_t addr, uint8_t memaddr, volatile uint8_t *buf, uint8_t nbytes);
+
+
+/**
+ * @brief  Read into buf from the peripheral with 16-bit memory address,
+ *         such as AT24C32 EEPROM.
+ * @param  addr Slave address
+ * @param  memaddr Starting address, sent MSB first
+ * @param  buf Buffer to be read into
+ * @param  nbytes Number of bytes
+ * @return Status code of the transaction, TWI_XFER_OK on success
+ */
+uint8_t twi_readfrom_mem16_into(uint8_t addr, uint16_t memaddr, volatile uint8_t *buf, uint8_t nbytes);
+
+
+/**
+ * @brief  Write buf to the peripheral, starting from the memory address.
+ * @param  addr Slave address
+ * @param  memaddr Starting address
+ * @param  buf Data to be written
+ * @param  nbytes Number of bytes
+ * @return Status code of the transaction, TWI_XFER_OK on success
+ */
+uint8_t twi_writeto_mem(uint8_t addr, uint8_t memaddr, const uint8_t *buf, uint8_t nbytes);
+
+
+/**
+ * @brief  Write buf to the peripheral with 16-bit memory address, such
+ *         as AT24C32 EEPROM.
+ * @param  addr Slave address
+ * @param  memaddr Starting address, sent MSB first
+ * @param  buf Data to be written
+ * @param  nbytes Number of bytes, at most 32 within one AT24C32 page
+ * @return Status code of the transaction, TWI_XFER_OK on success
+ */
+uint8_t twi_writeto_mem16(uint8_t addr, uint16_t memaddr, const uint8_t *buf, uint8_t nbytes);
+
+
+/**
+ * @brief  Write two buffers to the peripheral in one transaction without
+ *         copying them, e.g. memory address and payload.
+ * @param  addr Slave address
+ * @param  buf1 First buffer
+ * @param  len1 Number of bytes in buf1
+ * @param  buf2 Second buffer
+ * @param  len2 Number of bytes in buf2
+ * @return Status code of the transaction, TWI_XFER_OK on success
+ */
+uint8_t twi_writevto(uint8_t addr, const uint8_t *buf1, uint8_t len1, const uint8_t *buf2, uint8_t len2);
+
+
+/**
+ * @brief  Initialize register cache, all registers are invalid.
+ * @param  c Cache structure
+ * @param  addr Slave address
+ * @param  first First cached register
+ * @param  count Number of cached registers
+ * @param  shadow Buffer of count bytes
+ * @param  valid Buffer of (count+7)/8 bytes
+ * @return none
+ */
+void twi_cache_init(twi_cache_t *c, uint8_t addr, uint8_t first, uint8_t count,
+                    uint8_t *shadow, uint8_t *valid);
+
+
+/**
+ * @brief  Read all cached registers from the device in one transaction.
+ * @param  c Cache structure
+ * @return Status code, TWI_XFER_OK on success
+ */
+uint8_t twi_cache_load(twi_cache_t *c);
+
+
+/**
+ * @brief  Mark all registers invalid, e.g. after reset of the device.
+ * @param  c Cache structure
+ * @return none
+ */
+void twi_cache_invalidate(twi_cache_t *c);
+
+
+/**
+ * @brief  Read register, from RAM if valid.
+ * @param  c Cache structure
+ * @param  reg Register address; registers out of range are read from the bus
+ * @param  value Read value
+ * @return Status code, TWI_XFER_OK on success
+ */
+uint8_t twi_cache_read(twi_cache_t *c, uint8_t reg, uint8_t *value);
+
+
+/**
+ * @brief  Write register unless the cached value is the same.
+ * @param  c Cache structure
+ * @param  reg Register address
+ * @param  value Value to be written
+ * @return Status code, TWI_XFER_OK on success or if skipped
+ */
+uint8_t twi_cache_write(twi_cache_t *c, uint8_t reg, uint8_t value);
+
+
+/**
+ * @brief  Change bits of register without read-modify-write on the bus.
+ * @param  c Cache structure
+ * @param  reg Register address
+ * @param  mask Bits to be changed
+ * @param  value New value of the bits
+ * @return Status code, TWI_XFER_OK on success or if skipped
+ * @note   The register is read from the bus only if it is not valid.
+ */
+uint8_t twi_cache_update(twi_cache_t *c, uint8_t reg, uint8_t mask, uint8_t value);
+
+
+/**
+ * @brief  Release the bus held by a slave after a reset or brown-out.
+ * @par    Implementation notes:
+ *           - TWI unit is disabled and up to 9 SCL pulses are generated
+ *             by GPIO until the slave releases SDA
+ *           - STOP condition is generated and TWI is enabled again
+ *           - Called automatically after TWI_ERR_TIMEOUT
+ * @return Status code
+ * @retval 0 - Both SDA and SCL are high
+ * @retval TWI_ERR_BUS - Bus is still held low
+ */
+uint8_t twi_bus_recover(void);
+
+
+/**
+ * @brief  Queue transaction to be executed by the TWI interrupt.
+ * @param  x Transaction descriptor, its status is set to TWI_XFER_PENDING
+ * @return Queuing result
+ * @retval 1 - Transaction has been queued
+ * @retval 0 - Queue is full
+ * @note   Global interrupts must be enabled, otherwise the queue is only
+ *         processed by twi_transfer() and the blocking functions.
+ */
+uint8_t twi_submit(twi_xfer_t *x);
+
+
+/**
+ * @brief  Queue transaction and wait for its completion.
+ * @param  x Transaction descriptor
+ * @return Final status of the transaction, TWI_XFER_OK on success
+ * @retval TWI_ERR_BUS - Called with interrupts disabled while the bus
+ *         is owned by twi_start() ... twi_stop(); nothing is sent
+ * @note   Can be called with interrupts disabled, e.g. from another
+ *         interrupt handler; the TWI is then serviced by polling.
+ *         Transaction is aborted with TWI_ERR_TIMEOUT if there is no
+ *         bus event within TWI_TIMEOUT_US.
+ */
+uint8_t twi_transfer(twi_xfer_t *x);
+
+
+/**
+ * @brief  Test if the transaction queue is being processed.
+ * @return 1 if a transaction is in progress, 0 if the queue is empty
+ */
+uint8_t twi_busy(void);
+
+
+/**
+ * @brief  Find all devices on the bus.
+ *
+ * Only the address (SLA+W) of each device is sent at TWI_SCAN_HZ;
+ * reserved addresses 0x00-0x07 and 0x78-0x7f are skipped. The 112
+ * probes take about 11 SCL periods each, i.e. about 3.5 ms at 400 kHz
+ * compared to more than 12 ms at 100 kHz with twi_test_address().
+ *
+ * @param  bitmap Array of 16 bytes, bit (addr & 7) of bitmap[addr >> 3]
+ *         is set if device at addr acknowledged
+ * @return Number of devices found
+ */
+uint8_t twi_scan(uint8_t bitmap[16]);
+
+
+/**
+ * @brief  Identify device by its chip ID register.
+ *
+ * Known parts: BMP280, BME280, BME680 (0x76, 0x77, register 0xd0),
+ * MPU-6050, MPU-6500, MPU-9250 (0x68, 0x69, register 0x75), HMC5883L
+ * (0x1e, register 0x0a), and ADXL345 (0x1d, 0x53, register 0x00).
+ *
+ * @param  addr Slave address
+ * @return Name of the part in program memory, e.g. for uart_puts_p(),
+ *         or NULL if the part is not known
+ */
+const char *twi_identify(uint8_t addr);
+
+
+/**
+ * @brief  Serve register file as I2C slave device.
+ *
+ * The first byte written by master selects the register; next bytes are
+ * written to or read from the consecutive registers, wrapping around
+ * at size. Writes to read-only registers are acknowledged but ignored.
+ * All replies are served from the TWI interrupt, master mode can be used
+ * at the same time.
+ *
+ * @param  addr Own 7-bit slave address
+ * @param  regs Register file, or NULL to disable slave mode
+ * @param  size Number of registers, 1 to 255
+ * @param  ro_mask Bitmask of read-only registers (bit n of ro_mask[n/8]),
+ *         or NULL if all registers are writable
+ * @param  callback Called from the interrupt after STOP with the first
+ *         register and the number of bytes written by master, or NULL
+ * @return none
+ */
+void twi_slave_init(uint8_t addr, volatile uint8_t *regs, uint8_t size,
+                    const uint8_t *ro_mask, void (*callback)(uint8_t reg, uint8_t len));
+
+
+/**
+ * @brief  Watchdog and backoff timer of queued transactions.
+ *
+ * Call periodically, e.g. from a timer interrupt, with a period longer
+ * than TWI_TIMEOUT_US. The transaction in progress is aborted with
+ * TWI_ERR_TIMEOUT and the bus is recovered if no bus event occurred
+ * since the previous call. Not needed with twi_transfer().
+ *
+ * If arbitration is lost to another master (status 0x38), the queued
+ * transaction releases the bus and is restarted after 1, 2, 4, 8, or 16
+ * calls of this function (or TWI_BACKOFF_US units in twi_transfer()),
+ * up to TWI_ARB_RETRIES times. No function busy-waits meanwhile.
+ *
+ * @return none
+ * @note   The bus recovery takes up to a few ms and global interrupts
+ *         are enabled meanwhile, so the calling interrupt handler can
+ *         be nested.
+ */
+void twi_tick(void);
+
+
+/**
+ * @brief  Copy multi-master counters.
+ * @param  stats Structure to be filled in
+ * @return none
+ */
+void twi_stats_get(twi_stats_t *stats);
+
+
+/**
+ * @brief  Clear multi-master counters.
  * @return none
  */
-void twi_readfrom_mem_into(uint8_t addr, uint8_t memaddr, volatile uint8_t *buf, uint8_t nbytes);
+void twi_stats_clear(void);
 
 /** @} */
 
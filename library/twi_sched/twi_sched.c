@@ -0,0 +1,231 @@
+/*
+ * I2C bus polling scheduler for AVR-GCC.
+ * (c) 2025 Tomas Fryza, MIT license
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+// -- Includes ---------------------------------------------
+#include <twi_sched.h>
+#include <util/atomic.h>
+
+
+// -- Global variables -------------------------------------
+static twi_sched_dev_t *twi_sched_devs[TWI_SCHED_DEVICES];  // Registered devices
+static uint8_t twi_sched_count;         // Number of registered devices
+static uint32_t twi_sched_scl_hz;       // Default SCL frequency
+static uint16_t twi_sched_tick_us;      // Tick period
+static uint32_t twi_sched_busy_us;      // Bus time of completed transactions
+static uint32_t twi_sched_ticks;        // Elapsed ticks
+
+
+// -- Local functions --------------------------------------
+/*
+ * Function: twi_sched_gcd()
+ * Purpose:  Greatest common divisor of two periods.
+ * Input(s): a, b - Periods
+ * Returns:  GCD of a and b
+ */
+static uint16_t twi_sched_gcd(uint16_t a, uint16_t b)
+{
+    uint16_t t;
+
+    while (b != 0) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+
+/*
+ * Function: twi_sched_pump()
+ * Purpose:  Queue due transactions while the TWI queue has free slots.
+ * Returns:  none
+ */
+static void twi_sched_pump(void)
+{
+    uint8_t i;
+    twi_sched_dev_t *dev;
+
+    for (i = 0; i < twi_sched_count; i++) {
+        dev = twi_sched_devs[i];
+        if (dev->due) {
+            if (!twi_submit(&dev->xfer))
+                break;
+            dev->due = 0;
+        }
+    }
+}
+
+
+/*
+ * Function: twi_sched_done()
+ * Purpose:  Completion callback of scheduled transactions; submit the
+ *           next due one so that transactions run back-to-back.
+ * Input(s): x - Completed transaction, first member of device structure
+ * Returns:  none
+ */
+static void twi_sched_done(twi_xfer_t *x)
+{
+    twi_sched_dev_t *dev = (twi_sched_dev_t *)x;
+
+    if (x->status == TWI_XFER_OK)
+        dev->fresh = 1;
+    else
+        dev->errors++;
+    twi_sched_busy_us += dev->cost_us;
+
+    twi_sched_pump();
+}
+
+
+// -- Functions --------------------------------------------
+/*
+ * Function: twi_sched_init()
+ * Purpose:  Remove all devices and set time base.
+ * Input(s): scl_hz - Default SCL frequency
+ *           tick_us - Period of twi_sched_tick() calls
+ * Returns:  none
+ */
+void twi_sched_init(uint32_t scl_hz, uint16_t tick_us)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        twi_sched_count = 0;
+        twi_sched_scl_hz = scl_hz;
+        twi_sched_tick_us = tick_us;
+        twi_sched_busy_us = 0;
+        twi_sched_ticks = 0;
+    }
+}
+
+
+/*
+ * Function: twi_sched_add()
+ * Purpose:  Register device with the first due tick which does not
+ *           collide with any registered device.
+ * Input(s): dev - Device structure
+ *           period - Period in ticks
+ *           xfer - Transaction to be repeated
+ *           buf - Destination buffer
+ * Returns:  1 if registered, 0 if there is no free slot
+ */
+uint8_t twi_sched_add(twi_sched_dev_t *dev, uint16_t period, const twi_xfer_t *xfer, volatile uint8_t *buf)
+{
+    uint16_t offset;
+    uint16_t g;
+    uint16_t bits;
+    uint32_t hz;
+    uint8_t i;
+
+    if (twi_sched_count >= TWI_SCHED_DEVICES)
+        return 0;
+    if (period == 0)
+        period = 1;
+
+    dev->xfer = *xfer;
+    dev->xfer.rbuf = buf;
+    dev->xfer.callback = twi_sched_done;
+    dev->xfer.status = TWI_XFER_OK;
+    dev->period = period;
+    dev->due = 0;
+    dev->fresh = 0;
+    dev->errors = 0;
+    dev->overruns = 0;
+
+    // Bus time: START, SLA and data bytes of 9 bits, repeated START, STOP
+    bits = 1 + 9 * (1 + xfer->wlen + xfer->wlen2) + 1;
+    if (xfer->rlen != 0)
+        bits += 1 + 9 * (1 + xfer->rlen);
+    hz = xfer->clock ? twi_clock_rate(xfer->clock) : twi_sched_scl_hz;
+    dev->cost_us = (uint32_t)bits * 1000000UL / hz;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // Two devices become due in the same tick only if their next
+        // due ticks are congruent modulo GCD of their periods
+        for (offset = 0; offset < period; offset++) {
+            for (i = 0; i < twi_sched_count; i++) {
+                g = twi_sched_gcd(period, twi_sched_devs[i]->period);
+                if (offset % g == twi_sched_devs[i]->countdown % g)
+                    break;
+            }
+            if (i == twi_sched_count)
+                break;
+        }
+        if (offset == period)
+            offset = twi_sched_count % period;  // No free phase, spread anyway
+
+        dev->countdown = offset;
+        twi_sched_devs[twi_sched_count++] = dev;
+    }
+    return 1;
+}
+
+
+/*
+ * Function: twi_sched_tick()
+ * Purpose:  Advance time by one tick and queue due transactions.
+ * Returns:  none
+ */
+void twi_sched_tick(void)
+{
+    uint8_t i;
+    twi_sched_dev_t *dev;
+
+    twi_sched_ticks++;
+    for (i = 0; i < twi_sched_count; i++) {
+        dev = twi_sched_devs[i];
+        if (dev->countdown == 0) {
+            dev->countdown = dev->period;
+            if (dev->due || dev->xfer.status == TWI_XFER_PENDING)
+                dev->overruns++;
+            else
+                dev->due = 1;
+        }
+        dev->countdown--;
+    }
+    twi_sched_pump();
+}
+
+
+/*
+ * Function: twi_sched_fresh()
+ * Purpose:  Test and clear the flag of new data.
+ * Input(s): dev - Device structure
+ * Returns:  1 if new data are available
+ */
+uint8_t twi_sched_fresh(twi_sched_dev_t *dev)
+{
+    uint8_t fresh;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        fresh = dev->fresh;
+        dev->fresh = 0;
+    }
+    return fresh;
+}
+
+
+/*
+ * Function: twi_sched_utilisation()
+ * Purpose:  Get bus utilisation since the previous call.
+ * Returns:  Utilisation in permille
+ */
+uint16_t twi_sched_utilisation(void)
+{
+    uint32_t busy_us;
+    uint32_t elapsed_ms;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        busy_us = twi_sched_busy_us;
+        elapsed_ms = twi_sched_ticks * twi_sched_tick_us / 1000;
+        twi_sched_busy_us = 0;
+        twi_sched_ticks = 0;
+    }
+    if (elapsed_ms == 0)
+        return 0;
+    busy_us /= elapsed_ms;  // us per ms = permille
+    return (busy_us > 1000) ? 1000 : busy_us;
+}
@@ -0,0 +1,116 @@
+#ifndef TWI_SCHED_H
+#define TWI_SCHED_H
+
+/*
+ * I2C bus polling scheduler for AVR-GCC.
+ * (c) 2025 Tomas Fryza, MIT license
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+/**
+ * @file 
+ * @defgroup fryza_twi_sched I2C Scheduler Library <twi_sched.h>
+ * @code #include <twi_sched.h> @endcode
+ *
+ * @brief Periodic polling of several I2C devices on one bus.
+ *
+ * Each device is registered with a period, a transaction descriptor
+ * and a destination buffer. twi_sched_tick() is called from a timer
+ * interrupt; due transactions are queued to the interrupt-driven TWI
+ * engine and run back-to-back, the next one is submitted from the
+ * completion callback of the previous one. Phases of the devices are
+ * staggered at registration so that two devices never become due in
+ * the same tick, if their periods allow it.
+ *
+ * Example: DHT12, DS3231, and MPU-6050 at 0.5 Hz, 1 Hz, and 200 Hz
+ * with 1 ms tick are registered with periods 2000, 1000, and 5.
+ *
+ * @note Destination buffers are written from the TWI interrupt; read
+ *       them after twi_sched_fresh() returns 1 and before the next
+ *       period expires.
+ * @copyright (c) 2025 Tomas Fryza, MIT license
+ * @{
+ */
+
+// -- Includes ---------------------------------------------
+#include <avr/io.h>
+#include <twi.h>
+
+
+// -- Defines ----------------------------------------------
+#ifndef TWI_SCHED_DEVICES
+#define TWI_SCHED_DEVICES 8 /**< @brief Maximum number of registered devices */
+#endif
+
+
+// -- Types ------------------------------------------------
+/**
+ * @brief Scheduled device. Allocated by the application, fields are
+ *        maintained by the scheduler.
+ */
+typedef struct {
+    twi_xfer_t xfer;            /**< @brief Transaction, must be the first member */
+    uint16_t period;            /**< @brief Period in ticks */
+    uint16_t countdown;         /**< @brief Ticks until the device is due */
+    uint32_t cost_us;           /**< @brief Estimated bus time of one transaction, may exceed 65 ms at 10 kHz */
+    volatile uint8_t due;       /**< @brief Waiting for a free queue slot */
+    volatile uint8_t fresh;     /**< @brief New data in destination buffer */
+    uint16_t errors;            /**< @brief Transactions which failed */
+    uint16_t overruns;          /**< @brief Periods skipped because the previous transaction was not done */
+} twi_sched_dev_t;
+
+
+// -- Function prototypes ----------------------------------
+/**
+ * @brief  Remove all devices and set time base.
+ * @param  scl_hz Default SCL frequency, as returned by twi_set_clock()
+ * @param  tick_us Period of twi_sched_tick() calls in microseconds
+ * @return none
+ */
+void twi_sched_init(uint32_t scl_hz, uint16_t tick_us);
+
+
+/**
+ * @brief  Register device to be polled periodically.
+ * @param  dev Device structure, must stay valid
+ * @param  period Period in ticks, at least 1
+ * @param  xfer Transaction to be repeated, copied into dev; its rbuf
+ *         and callback are replaced
+ * @param  buf Destination buffer of xfer->rlen bytes
+ * @return Registration result
+ * @retval 1 - Device has been registered
+ * @retval 0 - TWI_SCHED_DEVICES devices already registered
+ */
+uint8_t twi_sched_add(twi_sched_dev_t *dev, uint16_t period, const twi_xfer_t *xfer, volatile uint8_t *buf);
+
+
+/**
+ * @brief  Advance scheduler time by one tick and queue due transactions.
+ * @par    Implementation notes:
+ *           - Call from a timer interrupt, e.g. TIMER1_OVF_vect
+ *           - A device which is still running when it is due again
+ *             skips the period and its overruns counter is incremented
+ * @return none
+ */
+void twi_sched_tick(void);
+
+
+/**
+ * @brief  Test and clear the flag of new data of a device.
+ * @param  dev Device structure
+ * @return 1 if the destination buffer has been updated since the last call
+ */
+uint8_t twi_sched_fresh(twi_sched_dev_t *dev);
+
+
+/**
+ * @brief  Get bus utilisation since the previous call.
+ * @return Time of completed transactions per elapsed time, in permille
+ */
+uint16_t twi_sched_utilisation(void);
+
+/** @} */
+
+#endif
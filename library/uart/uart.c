@@ -39,6 +39,9 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <stdarg.h>
+#include <string.h>
 #include "uart.h"
 
 
@@ -47,16 +50,31 @@
  */
 
 /* size of RX/TX buffers */
-#define UART_RX_BUFFER_MASK ( UART_RX_BUFFER_SIZE - 1)
-#define UART_TX_BUFFER_MASK ( UART_TX_BUFFER_SIZE - 1)
+#define UART0_RX_BUFFER_MASK ( UART0_RX_BUFFER_SIZE - 1)
+#define UART0_TX_BUFFER_MASK ( UART0_TX_BUFFER_SIZE - 1)
+#define UART1_RX_BUFFER_MASK ( UART1_RX_BUFFER_SIZE - 1)
+#define UART1_TX_BUFFER_MASK ( UART1_TX_BUFFER_SIZE - 1)
 
-#if ( UART_RX_BUFFER_SIZE & UART_RX_BUFFER_MASK )
+#if ( UART0_RX_BUFFER_SIZE & UART0_RX_BUFFER_MASK ) || ( UART1_RX_BUFFER_SIZE & UART1_RX_BUFFER_MASK )
 # error RX buffer size is not a power of 2
 #endif
-#if ( UART_TX_BUFFER_SIZE & UART_TX_BUFFER_MASK )
+#if ( UART0_TX_BUFFER_SIZE & UART0_TX_BUFFER_MASK ) || ( UART1_TX_BUFFER_SIZE & UART1_TX_BUFFER_MASK )
 # error TX buffer size is not a power of 2
 #endif
 
+#if UART_RX_LINE_MODE
+# define UART_RX_LINES_MASK ( UART_RX_LINES - 1)
+# if ( UART_RX_LINES & UART_RX_LINES_MASK )
+#  error UART_RX_LINES is not a power of 2
+# endif
+# if ( UART_RX_LINE_MAX >= UART0_RX_BUFFER_SIZE ) || ( UART_RX_LINE_MAX > 255 )
+#  error UART_RX_LINE_MAX must be smaller than UART0_RX_BUFFER_SIZE and 256
+# endif
+#endif
+
+/* generic port functions are inlined per port, so all descriptor fields fold to constants */
+#define UART_INLINE static inline __attribute__((always_inline))
+
 
 #if defined(__AVR_AT90S2313__) || defined(__AVR_AT90S4414__) || defined(__AVR_AT90S8515__) || \
     defined(__AVR_AT90S4434__) || defined(__AVR_AT90S8535__) || \
@@ -335,417 +353,1516 @@
 #endif /* if defined(__AVR_AT90S2313__) || defined(__AVR_AT90S4414__) || defined(__AVR_AT90S8515__) || defined(__AVR_AT90S4434__) || defined(__AVR_AT90S8535__) || defined(__AVR_ATmega103__) */
 
 
+/* FEn (Frame Error) DORn (Data OverRun) UPEn (USART Parity Error) bits */
+#if defined(FE) && defined(DOR) && defined(UPE)
+# define UART0_RX_ERRORS (_BV(FE) | _BV(DOR) | _BV(UPE) )
+#elif defined(FE0) && defined(DOR0) && defined(UPE0)
+# define UART0_RX_ERRORS (_BV(FE0) | _BV(DOR0) | _BV(UPE0) )
+#elif defined(FE1) && defined(DOR1) && defined(UPE1)
+# define UART0_RX_ERRORS (_BV(FE1) | _BV(DOR1) | _BV(UPE1) )
+#elif defined(FE) && defined(DOR)
+# define UART0_RX_ERRORS (_BV(FE) | _BV(DOR) )
+#else
+# define UART0_RX_ERRORS 0
+#endif
+
+/* double speed bit and frame format: asynchronous, 8data, no parity, 1stop bit */
+#if UART0_BIT_U2X
+# define UART0_U2X _BV(UART0_BIT_U2X)
+#else
+# define UART0_U2X 0
+#endif
+#ifdef UART0_CONTROLC
+# ifdef UART0_BIT_URSEL
+#  define UART0_CONTROLC_INIT ((1 << UART0_BIT_URSEL) | (1 << UART0_BIT_UCSZ1) | (1 << UART0_BIT_UCSZ0))
+# else
+#  define UART0_CONTROLC_INIT ((1 << UART0_BIT_UCSZ1) | (1 << UART0_BIT_UCSZ0))
+# endif
+#endif
+
+#if defined( ATMEGA_USART1 )
+# define UART1_RX_ERRORS (_BV(FE1) | _BV(DOR1) | _BV(UPE1) )
+# if UART1_BIT_U2X
+#  define UART1_U2X _BV(UART1_BIT_U2X)
+# else
+#  define UART1_U2X 0
+# endif
+# ifdef UART1_BIT_URSEL
+#  define UART1_CONTROLC_INIT ((1 << UART1_BIT_URSEL) | (1 << UART1_BIT_UCSZ1) | (1 << UART1_BIT_UCSZ0))
+# else
+#  define UART1_CONTROLC_INIT ((1 << UART1_BIT_UCSZ1) | (1 << UART1_BIT_UCSZ0))
+# endif
+#endif
+
+#ifdef UART_TEST
+# ifndef UART0_BIT_U2X
+#  warning "UART0_BIT_U2X not defined"
+# endif
+# ifndef UART0_UBRRH
+#  warning "UART0_UBRRH not defined"
+# endif
+# ifndef UART0_CONTROLC
+#  warning "UART0_CONTROLC not defined"
+# endif
+# if defined(URSEL) || defined(URSEL0)
+#  ifndef UART0_BIT_URSEL
+#   warning "UART0_BIT_URSEL not defined"
+#  endif
+# endif
+# if defined( ATMEGA_USART1 )
+#  ifndef UART1_BIT_U2X
+#   warning "UART1_BIT_U2X not defined"
+#  endif
+#  ifndef UART1_UBRRH
+#   warning "UART1_UBRRH not defined"
+#  endif
+#  ifndef UART1_CONTROLC
+#   warning "UART1_CONTROLC not defined"
+#  endif
+#  if defined(URSEL) || defined(URSEL1)
+#   ifndef UART1_BIT_URSEL
+#    warning "UART1_BIT_URSEL not defined"
+#   endif
+#  endif
+# endif
+#endif /* ifdef UART_TEST */
+
+
+/*
+ *  buffer indices, 16-bit if any buffer is larger than 256 bytes
+ */
+#if ( UART0_RX_BUFFER_SIZE > 256 ) || ( UART0_TX_BUFFER_SIZE > 256 ) || \
+    ( defined( ATMEGA_USART1 ) && (( UART1_RX_BUFFER_SIZE > 256 ) || ( UART1_TX_BUFFER_SIZE > 256 )) )
+# define UART_INDEX_16BIT 1
+typedef uint16_t uart_index_t;
+/* 16-bit index shared with an ISR must be accessed with interrupts disabled */
+# define UART_INDEX_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#else
+# define UART_INDEX_16BIT 0
+typedef unsigned char uart_index_t;
+# define UART_INDEX_ATOMIC
+#endif
+
+#if UART_ASM_ISR && UART_INDEX_16BIT
+# error "UART_ASM_ISR requires buffers of at most 256 bytes"
+#endif
+#if UART_ASM_ISR && UART_STATS
+# error "UART_ASM_ISR can not be combined with UART_STATS"
+#endif
+#if UART_ASM_ISR && UART_FLOW_CONTROL
+# error "UART_ASM_ISR can not be combined with UART_FLOW_CONTROL"
+#endif
+#if UART_ASM_ISR && UART_RX_IDLE
+# error "UART_ASM_ISR can not be combined with UART_RX_IDLE"
+#endif
+
+#if UART_RX_IDLE
+# define UART_RX_FRAMES_MASK ( UART_RX_FRAMES - 1)
+# if ( UART_RX_FRAMES & UART_RX_FRAMES_MASK )
+#  error UART_RX_FRAMES is not a power of 2
+# endif
+#endif
+
+#if UART_FLOW_CONTROL
+# if ( UART_RTS_LOW_WATER >= UART_RTS_HIGH_WATER ) || ( UART_RTS_HIGH_WATER >= UART0_RX_BUFFER_SIZE )
+#  error "UART_RTS_LOW_WATER < UART_RTS_HIGH_WATER < UART0_RX_BUFFER_SIZE required"
+# endif
+# define UART_DDR(_x) (*(&_x - 1))  /* Data Direction Register of port _x */
+# define UART_PIN(_x) (*(&_x - 2))  /* Input register of port _x */
+# define UART_CTS_BLOCKED() (UART_PIN(UART_CTS_PORT) & _BV(UART_CTS_PIN))
+#endif
+
+/* state of one port shared between ISRs and main program */
+typedef struct
+{
+    volatile uart_index_t  rx_head;
+    volatile uart_index_t  rx_tail;
+    volatile uart_index_t  tx_head;
+    volatile uart_index_t  tx_tail;
+    volatile unsigned char last_rx_error;
+    #if UART_STATS
+    uart_stats_t           stats;
+    #endif
+} uart_state_t;
+
+/* port descriptor, all fields are compile time constants */
+typedef struct
+{
+    volatile uint8_t       *status;
+    volatile uint8_t       *control;
+    volatile uint8_t       *controlc;      /* NULL if not available */
+    volatile uint8_t       *ubrrl;
+    volatile uint8_t       *ubrrh;         /* NULL if not available */
+    volatile uint8_t       *data;
+    unsigned char           u2x;           /* double speed bit mask */
+    unsigned char           udrie;         /* UDRE interrupt bit mask */
+    unsigned char           rx_errors;     /* FEn, DORn, UPEn bit mask */
+    unsigned char           control_init;
+    unsigned char           controlc_init;
+    volatile unsigned char *rx_buf;
+    volatile unsigned char *tx_buf;
+    uart_index_t            rx_mask;
+    uart_index_t            tx_mask;
+    uart_state_t           *state;
+} uart_port_t;
+
+
 /*
  *  module global variables
  */
-static volatile unsigned char UART_TxBuf[UART_TX_BUFFER_SIZE];
-static volatile unsigned char UART_RxBuf[UART_RX_BUFFER_SIZE];
-static volatile unsigned char UART_TxHead;
-static volatile unsigned char UART_TxTail;
-static volatile unsigned char UART_RxHead;
-static volatile unsigned char UART_RxTail;
-static volatile unsigned char UART_LastRxError;
+static volatile unsigned char UART_TxBuf[UART0_TX_BUFFER_SIZE];
+#if UART_RX_LINE_MODE
+/* first UART_RX_LINE_MAX bytes are mirrored behind the end of the buffer */
+static volatile unsigned char UART_RxBuf[UART0_RX_BUFFER_SIZE + UART_RX_LINE_MAX];
+#else
+static volatile unsigned char UART_RxBuf[UART0_RX_BUFFER_SIZE];
+#endif
+
+#if UART_RX_LINE_MODE
+static volatile unsigned char UART_RxLineQ[UART_RX_LINES];
+static volatile unsigned char UART_RxLineHead;
+static volatile unsigned char UART_RxLineTail;
+static volatile unsigned char UART_RxLineLen;
+#endif
+
+#if UART_RX_IDLE
+static volatile uint16_t      UART_RxFrameQ[UART_RX_FRAMES];
+static volatile unsigned char UART_RxFrameHead;
+static volatile unsigned char UART_RxFrameTail;
+static volatile uint16_t      UART_RxFrameLen;
+static unsigned char          UART_RxIdleClock;  /* Timer/Counter2 clock select bits */
+#endif
 
 #if defined( ATMEGA_USART1 )
-static volatile unsigned char UART1_TxBuf[UART_TX_BUFFER_SIZE];
-static volatile unsigned char UART1_RxBuf[UART_RX_BUFFER_SIZE];
-static volatile unsigned char UART1_TxHead;
-static volatile unsigned char UART1_TxTail;
-static volatile unsigned char UART1_RxHead;
-static volatile unsigned char UART1_RxTail;
-static volatile unsigned char UART1_LastRxError;
+static volatile unsigned char UART1_TxBuf[UART1_TX_BUFFER_SIZE];
+static volatile unsigned char UART1_RxBuf[UART1_RX_BUFFER_SIZE];
+# define UART_PORTS 2
+#else
+# define UART_PORTS 1
 #endif
 
+static uart_state_t uart_state[UART_PORTS];
+
+static const uart_port_t uart_port[UART_PORTS] =
+{
+    {
+        .status        = &UART0_STATUS,
+        .control       = &UART0_CONTROL,
+        #ifdef UART0_CONTROLC
+        .controlc      = &UART0_CONTROLC,
+        .controlc_init = UART0_CONTROLC_INIT,
+        #endif
+        .ubrrl         = &UART0_UBRRL,
+        #ifdef UART0_UBRRH
+        .ubrrh         = &UART0_UBRRH,
+        #endif
+        .data          = &UART0_DATA,
+        .u2x           = UART0_U2X,
+        .udrie         = _BV(UART0_UDRIE),
+        .rx_errors     = UART0_RX_ERRORS,
+        .control_init  = _BV(UART0_BIT_RXCIE) | (1 << UART0_BIT_RXEN) | (1 << UART0_BIT_TXEN),
+        .rx_buf        = UART_RxBuf,
+        .tx_buf        = UART_TxBuf,
+        .rx_mask       = UART0_RX_BUFFER_MASK,
+        .tx_mask       = UART0_TX_BUFFER_MASK,
+        .state         = &uart_state[0],
+    },
+#if defined( ATMEGA_USART1 )
+    {
+        .status        = &UART1_STATUS,
+        .control       = &UART1_CONTROL,
+        .controlc      = &UART1_CONTROLC,
+        .controlc_init = UART1_CONTROLC_INIT,
+        .ubrrl         = &UART1_UBRRL,
+        .ubrrh         = &UART1_UBRRH,
+        .data          = &UART1_DATA,
+        .u2x           = UART1_U2X,
+        .udrie         = _BV(UART1_UDRIE),
+        .rx_errors     = UART1_RX_ERRORS,
+        .control_init  = _BV(UART1_BIT_RXCIE) | (1 << UART1_BIT_RXEN) | (1 << UART1_BIT_TXEN),
+        .rx_buf        = UART1_RxBuf,
+        .tx_buf        = UART1_TxBuf,
+        .rx_mask       = UART1_RX_BUFFER_MASK,
+        .tx_mask       = UART1_TX_BUFFER_MASK,
+        .state         = &uart_state[1],
+    },
+#endif
+};
 
-ISR(UART0_RECEIVE_INTERRUPT)
 
 /*************************************************************************
- * Function: UART Receive Complete interrupt
- * Purpose:  called when the UART has received a character
+ * Function: uart_index_load()
+ * Purpose:  read buffer index which is written by an ISR
  **************************************************************************/
+UART_INLINE uart_index_t uart_index_load(volatile uart_index_t *idx)
 {
-    unsigned char tmphead;
+    uart_index_t value = 0;
+
+    UART_INDEX_ATOMIC
+    {
+        value = *idx;
+    }
+    return value;
+}
+
+/*************************************************************************
+ * Function: uart_index_store()
+ * Purpose:  write buffer index which is read by an ISR
+ **************************************************************************/
+UART_INLINE void uart_index_store(volatile uart_index_t *idx, uart_index_t value)
+{
+    UART_INDEX_ATOMIC
+    {
+        *idx = value;
+    }
+}
+
+
+/*************************************************************************
+ * Function: uart_port_rx_isr()
+ * Purpose:  receive complete handler of port n
+ **************************************************************************/
+UART_INLINE void uart_port_rx_isr(const unsigned char n)
+{
+    const uart_port_t *p  = &uart_port[n];
+    uart_state_t      *st = p->state;
+    uart_index_t tmphead;
     unsigned char data;
     unsigned char usr;
-    unsigned char lastRxError = 0;
+    unsigned char lastRxError;
+    #if UART_RX_LINE_MODE
+    unsigned char linelen = 0;
+    unsigned char tmpline = 0;
+    #endif
+    #if UART_STATS && defined(UART_STATS_TIMER)
+    uint16_t start = UART_STATS_TIMER;
+    #endif
 
 
     /* read UART status register and UART data register */
-    usr  = UART0_STATUS;
-    data = UART0_DATA;
+    usr  = *p->status;
+    data = *p->data;
 
     /* get FEn (Frame Error) DORn (Data OverRun) UPEn (USART Parity Error) bits */
-    #if defined(FE) && defined(DOR) && defined(UPE)
-    lastRxError = usr & (_BV(FE) | _BV(DOR) | _BV(UPE) );
-    #elif defined(FE0) && defined(DOR0) && defined(UPE0)
-    lastRxError = usr & (_BV(FE0) | _BV(DOR0) | _BV(UPE0) );
-    #elif defined(FE1) && defined(DOR1) && defined(UPE1)
-    lastRxError = usr & (_BV(FE1) | _BV(DOR1) | _BV(UPE1) );
-    #elif defined(FE) && defined(DOR)
-    lastRxError = usr & (_BV(FE) | _BV(DOR) );
+    lastRxError = usr & p->rx_errors;
+
+    #if UART_RX_IDLE
+    if (n == 0)
+    {
+        /* restart idle timeout */
+        TCNT2  = 0;
+        TIFR2  = _BV(OCF2A);
+        TCCR2B = UART_RxIdleClock;
+    }
     #endif
 
     /* calculate buffer index */
-    tmphead = ( UART_RxHead + 1) & UART_RX_BUFFER_MASK;
+    tmphead = ( st->rx_head + 1) & p->rx_mask;
+
+    #if UART_RX_LINE_MODE
+    if (n == 0)
+    {
+        linelen = UART_RxLineLen + 1;
+        tmpline = UART_RxLineHead;
+        if ((data == UART_RX_DELIMITER) || (linelen >= UART_RX_LINE_MAX))
+        {
+            /* this byte completes a line, reserve an entry in the line queue */
+            tmpline = (tmpline + 1) & UART_RX_LINES_MASK;
+            if (tmpline == UART_RxLineTail)
+            {
+                tmphead = st->rx_tail; /* line queue full, handle as buffer overflow */
+            }
+        }
+    }
+    #endif
 
-    if (tmphead == UART_RxTail)
+    if (tmphead == st->rx_tail)
     {
         /* error: receive buffer overflow */
         lastRxError = UART_BUFFER_OVERFLOW >> 8;
+        #if UART_STATS
+        st->stats.rx_overflows++;
+        #endif
     }
     else
     {
         /* store new index */
-        UART_RxHead = tmphead;
+        st->rx_head = tmphead;
         /* store received data in buffer */
-        UART_RxBuf[tmphead] = data;
-    }
-    UART_LastRxError |= lastRxError;
-}
+        p->rx_buf[tmphead] = data;
 
+        #if UART_STATS
+        st->stats.rx_bytes++;
+        if (((tmphead - st->rx_tail) & p->rx_mask) > st->stats.rx_peak)
+            st->stats.rx_peak = (tmphead - st->rx_tail) & p->rx_mask;
+        #endif
 
-ISR(UART0_TRANSMIT_INTERRUPT)
+        #if UART_RX_IDLE
+        if (n == 0)
+            UART_RxFrameLen++;
+        #endif
+
+        #if UART_FLOW_CONTROL
+        /* buffer nearly full, ask the peer to pause */
+        if ((n == 0) && (((tmphead - st->rx_tail) & p->rx_mask) >= UART_RTS_HIGH_WATER))
+            UART_RTS_PORT |= _BV(UART_RTS_PIN);
+        #endif
+
+        #if UART_RX_LINE_MODE
+        if (n == 0)
+        {
+            /* mirror the start of the buffer, so wrapped lines stay contiguous */
+            if (tmphead < UART_RX_LINE_MAX)
+                UART_RxBuf[UART0_RX_BUFFER_SIZE + tmphead] = data;
+
+            if (tmpline != UART_RxLineHead)
+            {
+                /* publish length of the complete line */
+                UART_RxLineQ[tmpline] = linelen;
+                UART_RxLineHead       = tmpline;
+                linelen               = 0;
+            }
+            UART_RxLineLen = linelen;
+        }
+        #endif
+    }
+    st->last_rx_error |= lastRxError;
+
+    #if UART_STATS
+    if (usr & (UART_FRAME_ERROR >> 8))
+        st->stats.frame_errors++;
+    if (usr & (UART_OVERRUN_ERROR >> 8))
+        st->stats.overrun_errors++;
+    if (usr & (UART_PARITY_ERROR >> 8))
+        st->stats.parity_errors++;
+    #endif
+    #if UART_STATS && defined(UART_STATS_TIMER)
+    start = UART_STATS_TIMER - start;
+    if (start > st->stats.rx_isr_ticks)
+        st->stats.rx_isr_ticks = start;
+    #endif
+}
 
 /*************************************************************************
- * Function: UART Data Register Empty interrupt
- * Purpose:  called when the UART is ready to transmit the next byte
+ * Function: uart_port_tx_isr()
+ * Purpose:  data register empty handler of port n
  **************************************************************************/
+UART_INLINE void uart_port_tx_isr(const unsigned char n)
 {
-    unsigned char tmptail;
+    const uart_port_t *p  = &uart_port[n];
+    uart_state_t      *st = p->state;
+    uart_index_t tmptail;
+    #if UART_STATS && defined(UART_STATS_TIMER)
+    uint16_t start = UART_STATS_TIMER;
+    #endif
 
 
-    if (UART_TxHead != UART_TxTail)
+    #if UART_FLOW_CONTROL
+    if ((n == 0) && UART_CTS_BLOCKED())
+    {
+        /* peer is not ready, pause until CTS pin change interrupt */
+        *p->control &= ~p->udrie;
+    }
+    else
+    #endif
+    if (st->tx_head != st->tx_tail)
     {
         /* calculate and store new buffer index */
-        tmptail     = (UART_TxTail + 1) & UART_TX_BUFFER_MASK;
-        UART_TxTail = tmptail;
+        tmptail     = (st->tx_tail + 1) & p->tx_mask;
+        st->tx_tail = tmptail;
         /* get one byte from buffer and write it to UART */
-        UART0_DATA = UART_TxBuf[tmptail]; /* start transmission */
+        *p->data = p->tx_buf[tmptail]; /* start transmission */
+        #if UART_STATS
+        st->stats.tx_bytes++;
+        #endif
     }
     else
     {
         /* tx buffer empty, disable UDRE interrupt */
-        UART0_CONTROL &= ~_BV(UART0_UDRIE);
+        *p->control &= ~p->udrie;
     }
+
+    #if UART_STATS && defined(UART_STATS_TIMER)
+    start = UART_STATS_TIMER - start;
+    if (start > st->stats.tx_isr_ticks)
+        st->stats.tx_isr_ticks = start;
+    #endif
 }
 
+#if UART_RX_IDLE
+/*************************************************************************
+ * Function: uart_idle_init()
+ * Purpose:  set Timer/Counter2 to UART_RX_IDLE_BITS bit times of baudrate
+ **************************************************************************/
+static void uart_idle_init(unsigned int baudrate)
+{
+    static const uint16_t prescaler[] = {1, 8, 32, 64, 128, 256, 1024};
+    uint32_t cycles;
+    unsigned char cs;
+
+
+    /* one bit takes (UBRR+1)*16 CPU cycles, (UBRR+1)*8 in double speed mode */
+    cycles = (uint32_t)UART_RX_IDLE_BITS * ((baudrate & 0x0FFF) + 1) * ((baudrate & 0x8000) ? 8 : 16);
+
+    /* smallest prescaler which fits the timeout into 8 bits */
+    for (cs = 0; (cs < 6) && (cycles > 256UL * prescaler[cs]); cs++)
+        ;
+    cycles = (cycles + prescaler[cs] - 1) / prescaler[cs];
+    if (cycles > 256)
+        cycles = 256;
+
+    UART_RxFrameHead = 0;
+    UART_RxFrameTail = 0;
+    UART_RxFrameLen  = 0;
+    UART_RxIdleClock = cs + 1;
+
+    /* CTC mode, stopped until the first byte is received */
+    TCCR2B = 0;
+    TCCR2A = _BV(WGM21);
+    OCR2A  = cycles - 1;
+    TIMSK2 |= _BV(OCIE2A);
+}
+#endif /* if UART_RX_IDLE */
 
 /*************************************************************************
- * Function: uart_init()
- * Purpose:  initialize UART and set baudrate
- * Input:    baudrate using macro UART_BAUD_SELECT()
- * Returns:  none
+ * Function: uart_port_init()
+ * Purpose:  initialize port n and set baudrate
  **************************************************************************/
-void uart_init(unsigned int baudrate)
+UART_INLINE void uart_port_init(const unsigned char n, unsigned int baudrate)
 {
-    UART_TxHead = 0;
-    UART_TxTail = 0;
-    UART_RxHead = 0;
-    UART_RxTail = 0;
-
-    #ifdef UART_TEST
-    # ifndef UART0_BIT_U2X
-    #  warning "UART0_BIT_U2X not defined"
-    # endif
-    # ifndef UART0_UBRRH
-    #  warning "UART0_UBRRH not defined"
-    # endif
-    # ifndef UART0_CONTROLC
-    #  warning "UART0_CONTROLC not defined"
-    # endif
-    # if defined(URSEL) || defined(URSEL0)
-    #  ifndef UART0_BIT_URSEL
-    #   warning "UART0_BIT_URSEL not defined"
-    #  endif
-    # endif
-    #endif /* ifdef UART_TEST */
+    const uart_port_t *p  = &uart_port[n];
+    uart_state_t      *st = p->state;
 
-    /* Set baud rate */
-    if (baudrate & 0x8000)
+
+    UART_INDEX_ATOMIC
     {
-        #if UART0_BIT_U2X
-        UART0_STATUS = (1 << UART0_BIT_U2X); // Enable 2x speed
+        st->tx_head = 0;
+        st->tx_tail = 0;
+        st->rx_head = 0;
+        st->rx_tail = 0;
+        #if UART_RX_LINE_MODE
+        if (n == 0)
+        {
+            UART_RxLineHead = 0;
+            UART_RxLineTail = 0;
+            UART_RxLineLen  = 0;
+        }
+        #endif
+        #if UART_STATS
+        memset(&st->stats, 0, sizeof(st->stats));
         #endif
     }
-    #if defined(UART0_UBRRH)
-    UART0_UBRRH = (unsigned char) ((baudrate >> 8) & 0x80);
-    #endif
-    UART0_UBRRL = (unsigned char) (baudrate & 0x00FF);
+
+    /* Set baud rate */
+    if ((baudrate & 0x8000) && p->u2x)
+    {
+        *p->status = p->u2x; // Enable 2x speed
+    }
+    if (p->ubrrh)
+    {
+        *p->ubrrh = (unsigned char) ((baudrate >> 8) & 0x80);
+    }
+    *p->ubrrl = (unsigned char) (baudrate & 0x00FF);
 
     /* Enable USART receiver and transmitter and receive complete interrupt */
-    UART0_CONTROL = _BV(UART0_BIT_RXCIE) | (1 << UART0_BIT_RXEN) | (1 << UART0_BIT_TXEN);
+    *p->control = p->control_init;
 
     /* Set frame format: asynchronous, 8data, no parity, 1stop bit */
-    #ifdef UART0_CONTROLC
-    # ifdef UART0_BIT_URSEL
-    UART0_CONTROLC = (1 << UART0_BIT_URSEL) | (1 << UART0_BIT_UCSZ1) | (1 << UART0_BIT_UCSZ0);
-    # else
-    UART0_CONTROLC = (1 << UART0_BIT_UCSZ1) | (1 << UART0_BIT_UCSZ0);
-    # endif
+    if (p->controlc)
+    {
+        *p->controlc = p->controlc_init;
+    }
+
+    #if UART_RX_IDLE
+    if (n == 0)
+    {
+        uart_idle_init(baudrate);
+    }
     #endif
-}/* uart_init */
+
+    #if UART_FLOW_CONTROL
+    if (n == 0)
+    {
+        /* RTS output low (ready), CTS input with pull-up and pin change interrupt */
+        UART_RTS_PORT &= ~_BV(UART_RTS_PIN);
+        UART_DDR(UART_RTS_PORT) |= _BV(UART_RTS_PIN);
+        UART_DDR(UART_CTS_PORT) &= ~_BV(UART_CTS_PIN);
+        UART_CTS_PORT |= _BV(UART_CTS_PIN);
+        UART_CTS_PCMSK |= _BV(UART_CTS_PCINT);
+        PCICR |= _BV(UART_CTS_PCIE);
+    }
+    #endif
+}
 
 /*************************************************************************
- * Function: uart_getc()
- * Purpose:  return byte from ringbuffer
- * Returns:  lower byte:  received byte from ringbuffer
- *        higher byte: last receive error
+ * Function: uart_port_rts_update()
+ * Purpose:  let the peer send again once receive buffer of port n has room
  **************************************************************************/
-unsigned int uart_getc(void)
+UART_INLINE void uart_port_rts_update(const unsigned char n)
 {
-    unsigned char tmptail;
+    #if UART_FLOW_CONTROL
+    const uart_port_t *p  = &uart_port[n];
+    uart_state_t      *st = p->state;
+
+    if ((n == 0) && (((uart_index_t)(uart_index_load(&st->rx_head) - st->rx_tail) & p->rx_mask) <= UART_RTS_LOW_WATER))
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            UART_RTS_PORT &= ~_BV(UART_RTS_PIN);
+        }
+    }
+    #else
+    (void)n;
+    #endif
+}
+
+/*************************************************************************
+ * Function: uart_port_getc()
+ * Purpose:  return byte from ringbuffer of port n
+ **************************************************************************/
+UART_INLINE unsigned int uart_port_getc(const unsigned char n)
+{
+    const uart_port_t *p  = &uart_port[n];
+    uart_state_t      *st = p->state;
+    uart_index_t tmptail;
     unsigned char data;
     unsigned char lastRxError;
 
 
-    if (UART_RxHead == UART_RxTail)
+    if (uart_index_load(&st->rx_head) == st->rx_tail)
     {
         return UART_NO_DATA; /* no data available */
     }
 
     /* calculate buffer index */
-    tmptail = (UART_RxTail + 1) & UART_RX_BUFFER_MASK;
+    tmptail = (st->rx_tail + 1) & p->rx_mask;
 
     /* get data from receive buffer */
-    data        = UART_RxBuf[tmptail];
-    lastRxError = UART_LastRxError;
+    data        = p->rx_buf[tmptail];
+    lastRxError = st->last_rx_error;
 
     /* store buffer index */
-    UART_RxTail = tmptail;
+    uart_index_store(&st->rx_tail, tmptail);
+    uart_port_rts_update(n);
 
-    UART_LastRxError = 0;
+    st->last_rx_error = 0;
     return (lastRxError << 8) + data;
-}/* uart_getc */
+}
 
 /*************************************************************************
- * Function: uart_putc()
- * Purpose:  write byte to ringbuffer for transmitting via UART
- * Input:    byte to be transmitted
- * Returns:  none
+ * Function: uart_port_tx_free()
+ * Purpose:  return number of free bytes in transmit ringbuffer of port n
  **************************************************************************/
-void uart_putc(unsigned char data)
+UART_INLINE uint16_t uart_port_tx_free(const unsigned char n)
 {
-    unsigned char tmphead;
+    const uart_port_t *p  = &uart_port[n];
+    uart_state_t      *st = p->state;
+
+    /* one slot is always left empty to distinguish full from empty */
+    return (uart_index_t)(uart_index_load(&st->tx_tail) - st->tx_head - 1) & p->tx_mask;
+}
+
+/*************************************************************************
+ * Function: uart_port_tx_peak()
+ * Purpose:  update transmit high-water mark of port n after head has moved
+ **************************************************************************/
+UART_INLINE void uart_port_tx_peak(const unsigned char n, uart_index_t tmphead)
+{
+    #if UART_STATS
+    const uart_port_t *p  = &uart_port[n];
+    uart_state_t      *st = p->state;
+    uint16_t used;
+
+    used = (uart_index_t)(tmphead - uart_index_load(&st->tx_tail)) & p->tx_mask;
+    if (used > st->stats.tx_peak)
+        st->stats.tx_peak = used;
+    #else
+    (void)n;
+    (void)tmphead;
+    #endif
+}
+
+/*************************************************************************
+ * Function: uart_port_putc()
+ * Purpose:  write byte to ringbuffer of port n
+ **************************************************************************/
+UART_INLINE void uart_port_putc(const unsigned char n, unsigned char data)
+{
+    const uart_port_t *p  = &uart_port[n];
+    uart_state_t      *st = p->state;
+    uart_index_t tmphead;
 
 
-    tmphead = (UART_TxHead + 1) & UART_TX_BUFFER_MASK;
+    tmphead = (st->tx_head + 1) & p->tx_mask;
 
-    while (tmphead == UART_TxTail)
+    #if UART_TX_POLICY == UART_TX_DROP
+    if (tmphead == uart_index_load(&st->tx_tail))
+    {
+        #if UART_STATS
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            st->stats.tx_dropped++;
+        }
+        #endif
+        return; /* buffer full, discard new byte */
+    }
+    #elif UART_TX_POLICY == UART_TX_OVERWRITE
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (tmphead == st->tx_tail)
+        {
+            /* buffer full, discard oldest unsent byte */
+            st->tx_tail = (st->tx_tail + 1) & p->tx_mask;
+            #if UART_STATS
+            st->stats.tx_dropped++;
+            #endif
+        }
+    }
+    #else
+    while (tmphead == uart_index_load(&st->tx_tail))
     {
         ;/* wait for free space in buffer */
     }
+    #endif
 
-    UART_TxBuf[tmphead] = data;
-    UART_TxHead         = tmphead;
+    p->tx_buf[tmphead] = data;
+    uart_index_store(&st->tx_head, tmphead);
+    uart_port_tx_peak(n, tmphead);
 
     /* enable UDRE interrupt */
-    UART0_CONTROL |= _BV(UART0_UDRIE);
-}/* uart_putc */
+    *p->control |= p->udrie;
+}
 
 /*************************************************************************
- * Function: uart_puts()
- * Purpose:  transmit string to UART
- * Input:    string to be transmitted
- * Returns:  none
+ * Function: uart_port_try_putc()
+ * Purpose:  write byte to ringbuffer of port n only if there is free space
  **************************************************************************/
-void uart_puts(const char *s)
+UART_INLINE unsigned char uart_port_try_putc(const unsigned char n, unsigned char data)
 {
-    while (*s)
-        uart_putc(*s++);
-}/* uart_puts */
+    const uart_port_t *p  = &uart_port[n];
+    uart_state_t      *st = p->state;
+    uart_index_t tmphead;
 
-/*************************************************************************
- * Function: uart_puts_p()
- * Purpose:  transmit string from program memory to UART
- * Input:    program memory string to be transmitted
- * Returns:  none
- **************************************************************************/
-void uart_puts_p(const char *progmem_s)
-{
-    register char c;
 
-    while ( (c = pgm_read_byte(progmem_s++)) )
-        uart_putc(c);
-}/* uart_puts_p */
+    tmphead = (st->tx_head + 1) & p->tx_mask;
+    if (tmphead == uart_index_load(&st->tx_tail))
+    {
+        return 0;
+    }
 
-/*
- * these functions are only for ATmegas with two USART
- */
-#if defined( ATMEGA_USART1 )
+    p->tx_buf[tmphead] = data;
+    uart_index_store(&st->tx_head, tmphead);
+    uart_port_tx_peak(n, tmphead);
 
-ISR(UART1_RECEIVE_INTERRUPT)
+    /* enable UDRE interrupt */
+    *p->control |= p->udrie;
+    return 1;
+}
 
 /*************************************************************************
- * Function: UART1 Receive Complete interrupt
- * Purpose:  called when the UART1 has received a character
+ * Function: uart_port_write()
+ * Purpose:  copy block of bytes from RAM or program memory to ringbuffer
+ *           of port n in one pass
  **************************************************************************/
+UART_INLINE uint16_t uart_port_write(const unsigned char n, const void *buf, uint16_t len,
+                                     const unsigned char progmem)
 {
-    unsigned char tmphead;
-    unsigned char data;
-    unsigned char usr;
-    unsigned char lastRxError;
+    const uart_port_t *p  = &uart_port[n];
+    uart_state_t      *st = p->state;
+    const unsigned char *src = (const unsigned char *)buf;
+    uart_index_t tmphead;
+    uint16_t space;
+    uint16_t i;
+
+
+    /* free space, one slot is always left empty to distinguish full from empty */
+    tmphead = st->tx_head;
+    space   = (uart_index_t)(uart_index_load(&st->tx_tail) - tmphead - 1) & p->tx_mask;
+    if (len > space)
+        len = space;
+    if (len == 0)
+        return 0;
+
+    for (i = len; i; i--)
+    {
+        tmphead = (tmphead + 1) & p->tx_mask;
+        p->tx_buf[tmphead] = progmem ? pgm_read_byte(src++) : *src++;
+    }
 
+    /* publish new head once, then enable UDRE interrupt */
+    uart_index_store(&st->tx_head, tmphead);
+    uart_port_tx_peak(n, tmphead);
+    *p->control |= p->udrie;
 
-    /* read UART status register and UART data register */
-    usr  = UART1_STATUS;
-    data = UART1_DATA;
+    return len;
+}
 
-    /* get FEn (Frame Error) DORn (Data OverRun) UPEn (USART Parity Error) bits */
-    lastRxError = usr & (_BV(FE1) | _BV(DOR1) | _BV(UPE1) );
+/*************************************************************************
+ * Function: uart_port_tx_stage()
+ * Purpose:  store byte behind the head of port n without publishing it
+ **************************************************************************/
+UART_INLINE unsigned char uart_port_tx_stage(const unsigned char n, uint16_t offset, unsigned char data)
+{
+    const uart_port_t *p  = &uart_port[n];
+    uart_state_t      *st = p->state;
 
-    /* calculate buffer index */
-    tmphead = ( UART1_RxHead + 1) & UART_RX_BUFFER_MASK;
 
-    if (tmphead == UART1_RxTail)
+    if (offset >= p->tx_mask)
     {
-        /* error: receive buffer overflow */
-        lastRxError = UART_BUFFER_OVERFLOW >> 8;
+        return 0; /* never fits into the buffer */
     }
-    else
+
+    #if UART_TX_POLICY == UART_TX_BLOCK
+    while (offset >= uart_port_tx_free(n))
     {
-        /* store new index */
-        UART1_RxHead = tmphead;
-        /* store received data in buffer */
-        UART1_RxBuf[tmphead] = data;
+        ;/* wait for free space in buffer */
+    }
+    #else
+    if (offset >= uart_port_tx_free(n))
+    {
+        return 0;
     }
-    UART1_LastRxError |= lastRxError;
+    #endif
+
+    p->tx_buf[(st->tx_head + 1 + offset) & p->tx_mask] = data;
+    return 1;
 }
 
+/*************************************************************************
+ * Function: uart_port_tx_commit()
+ * Purpose:  publish len staged bytes of port n
+ **************************************************************************/
+UART_INLINE void uart_port_tx_commit(const unsigned char n, uint16_t len)
+{
+    const uart_port_t *p  = &uart_port[n];
+    uart_state_t      *st = p->state;
+    uart_index_t tmphead;
+
 
-ISR(UART1_TRANSMIT_INTERRUPT)
+    if (len == 0)
+        return;
+
+    tmphead = (st->tx_head + len) & p->tx_mask;
+    uart_index_store(&st->tx_head, tmphead);
+    uart_port_tx_peak(n, tmphead);
+
+    /* enable UDRE interrupt */
+    *p->control |= p->udrie;
+}
 
 /*************************************************************************
- * Function: UART1 Data Register Empty interrupt
- * Purpose:  called when the UART1 is ready to transmit the next byte
+ * Function: uart_port_puts()
+ * Purpose:  transmit string from RAM or program memory to port n
  **************************************************************************/
+UART_INLINE void uart_port_puts(const unsigned char n, const char *s, const unsigned char progmem)
 {
-    unsigned char tmptail;
+    uint16_t len = progmem ? strlen_P(s) : strlen(s);
+    uint16_t i;
 
+    i    = uart_port_write(n, s, len, progmem);
+    s   += i;
+    len -= i;
 
-    if (UART1_TxHead != UART1_TxTail)
-    {
-        /* calculate and store new buffer index */
-        tmptail      = (UART1_TxTail + 1) & UART_TX_BUFFER_MASK;
-        UART1_TxTail = tmptail;
-        /* get one byte from buffer and write it to UART */
-        UART1_DATA = UART1_TxBuf[tmptail]; /* start transmission */
-    }
-    else
+    /* remaining bytes are handled according to UART_TX_POLICY */
+    while (len--)
+        uart_port_putc(n, progmem ? pgm_read_byte(s++) : *s++);
+}
+
+#if UART_STATS
+/*************************************************************************
+ * Function: uart_port_stats_get()
+ * Purpose:  copy health counters of port n
+ **************************************************************************/
+UART_INLINE void uart_port_stats_get(const unsigned char n, uart_stats_t *stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        /* tx buffer empty, disable UDRE interrupt */
-        UART1_CONTROL &= ~_BV(UART1_UDRIE);
+        *stats = uart_port[n].state->stats;
     }
 }
 
-
 /*************************************************************************
- * Function: uart1_init()
- * Purpose:  initialize UART1 and set baudrate
- * Input:    baudrate using macro UART_BAUD_SELECT()
- * Returns:  none
+ * Function: uart_port_stats_clear()
+ * Purpose:  clear health counters of port n
  **************************************************************************/
-void uart1_init(unsigned int baudrate)
+UART_INLINE void uart_port_stats_clear(const unsigned char n)
 {
-    UART1_TxHead = 0;
-    UART1_TxTail = 0;
-    UART1_RxHead = 0;
-    UART1_RxTail = 0;
-
-    # ifdef UART_TEST
-    #  ifndef UART1_BIT_U2X
-    #   warning "UART1_BIT_U2X not defined"
-    #  endif
-    #  ifndef UART1_UBRRH
-    #   warning "UART1_UBRRH not defined"
-    #  endif
-    #  ifndef UART1_CONTROLC
-    #   warning "UART1_CONTROLC not defined"
-    #  endif
-    #  if defined(URSEL) || defined(URSEL1)
-    #   ifndef UART1_BIT_URSEL
-    #    warning "UART1_BIT_URSEL not defined"
-    #   endif
-    #  endif
-    # endif /* ifdef UART_TEST */
-
-    /* Set baud rate */
-    if (baudrate & 0x8000)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        # if UART1_BIT_U2X
-        UART1_STATUS = (1 << UART1_BIT_U2X); // Enable 2x speed
-        # endif
+        memset(&uart_port[n].state->stats, 0, sizeof(uart_stats_t));
     }
-    UART1_UBRRH = (unsigned char) ((baudrate >> 8) & 0x80);
-    UART1_UBRRL = (unsigned char) baudrate;
+}
+#endif /* if UART_STATS */
 
-    /* Enable USART receiver and transmitter and receive complete interrupt */
-    UART1_CONTROL = _BV(UART1_BIT_RXCIE) | (1 << UART1_BIT_RXEN) | (1 << UART1_BIT_TXEN);
 
-    /* Set frame format: asynchronous, 8data, no parity, 1stop bit */
-    # ifdef UART1_BIT_URSEL
-    UART1_CONTROLC = (1 << UART1_BIT_URSEL) | (1 << UART1_BIT_UCSZ1) | (1 << UART1_BIT_UCSZ0);
-    # else
-    UART1_CONTROLC = (1 << UART1_BIT_UCSZ1) | (1 << UART1_BIT_UCSZ0);
-    # endif
+#if UART_ASM_ISR
+
+#if UART_RX_LINE_MODE
+# error "UART_ASM_ISR can not be combined with UART_RX_LINE_MODE"
+#endif
+
+ISR(UART0_RECEIVE_INTERRUPT, ISR_NAKED)
+
+/*************************************************************************
+ * Function: UART Receive Complete interrupt, assembly version
+ * Purpose:  called when the UART has received a character
+ * Cycles:   55 incl. interrupt response, vector jump and reti,
+ *           +8 when an error flag is set
+ **************************************************************************/
+{
+    __asm__ __volatile__ (
+        "push r24                         \n\t"  /* 2  save registers */
+        "in   r24, __SREG__               \n\t"  /* 1 */
+        "push r24                         \n\t"  /* 2 */
+        "push r25                         \n\t"  /* 2 */
+        "push r30                         \n\t"  /* 2 */
+        "push r31                         \n\t"  /* 2 */
+        "lds  r25, %[status]              \n\t"  /* 2  status before data */
+        "lds  r24, %[data]                \n\t"  /* 2 */
+        "andi r25, %[errors]              \n\t"  /* 1  FE, DOR, UPE */
+        "lds  r30, %[head]                \n\t"  /* 2  tmphead = (head+1) & mask */
+        "inc  r30                         \n\t"  /* 1 */
+        "andi r30, %[mask]                \n\t"  /* 1 */
+        "lds  r31, %[tail]                \n\t"  /* 2 */
+        "cp   r30, r31                    \n\t"  /* 1 */
+        "breq 3f                          \n\t"  /* 1  buffer full */
+        "sts  %[head], r30                \n\t"  /* 2 */
+        "ldi  r31, 0                      \n\t"  /* 1  Z = &buf[tmphead] */
+        "subi r30, lo8(-(%[buf]))         \n\t"  /* 1 */
+        "sbci r31, hi8(-(%[buf]))         \n\t"  /* 1 */
+        "st   Z, r24                      \n\t"  /* 2 */
+        "tst  r25                         \n\t"  /* 1 */
+        "brne 2f                          \n\t"  /* 1  error flag set */
+        "1:                               \n\t"
+        "pop  r31                         \n\t"  /* 2  restore registers */
+        "pop  r30                         \n\t"  /* 2 */
+        "pop  r25                         \n\t"  /* 2 */
+        "pop  r24                         \n\t"  /* 2 */
+        "out  __SREG__, r24               \n\t"  /* 1 */
+        "pop  r24                         \n\t"  /* 2 */
+        "reti                             \n\t"  /* 4 */
+        "3:                               \n\t"
+        "ldi  r25, %[overflow]            \n\t"  /* receive buffer overflow */
+        "2:                               \n\t"
+        "lds  r24, %[error]               \n\t"  /* last_rx_error |= r25 */
+        "or   r24, r25                    \n\t"
+        "sts  %[error], r24               \n\t"
+        "rjmp 1b                          \n\t"
+        :
+        : [status]   "n" (_SFR_MEM_ADDR(UART0_STATUS)),
+          [data]     "n" (_SFR_MEM_ADDR(UART0_DATA)),
+          [errors]   "M" (UART0_RX_ERRORS),
+          [mask]     "M" (UART0_RX_BUFFER_MASK),
+          [overflow] "M" (UART_BUFFER_OVERFLOW >> 8),
+          [head]     "i" (&uart_state[0].rx_head),
+          [tail]     "i" (&uart_state[0].rx_tail),
+          [error]    "i" (&uart_state[0].last_rx_error),
+          [buf]      "i" (UART_RxBuf)
+    );
+}
+
+
+ISR(UART0_TRANSMIT_INTERRUPT, ISR_NAKED)
+
+/*************************************************************************
+ * Function: UART Data Register Empty interrupt, assembly version
+ * Purpose:  called when the UART is ready to transmit the next byte
+ * Cycles:   46 incl. interrupt response, vector jump and reti
+ **************************************************************************/
+{
+    __asm__ __volatile__ (
+        "push r24                         \n\t"  /* 2  save registers */
+        "in   r24, __SREG__               \n\t"  /* 1 */
+        "push r24                         \n\t"  /* 2 */
+        "push r30                         \n\t"  /* 2 */
+        "push r31                         \n\t"  /* 2 */
+        "lds  r30, %[tail]                \n\t"  /* 2 */
+        "lds  r24, %[head]                \n\t"  /* 2 */
+        "cp   r24, r30                    \n\t"  /* 1 */
+        "breq 2f                          \n\t"  /* 1  buffer empty */
+        "inc  r30                         \n\t"  /* 1  tmptail = (tail+1) & mask */
+        "andi r30, %[mask]                \n\t"  /* 1 */
+        "sts  %[tail], r30                \n\t"  /* 2 */
+        "ldi  r31, 0                      \n\t"  /* 1  Z = &buf[tmptail] */
+        "subi r30, lo8(-(%[buf]))         \n\t"  /* 1 */
+        "sbci r31, hi8(-(%[buf]))         \n\t"  /* 1 */
+        "ld   r24, Z                      \n\t"  /* 2 */
+        "sts  %[data], r24                \n\t"  /* 2  start transmission */
+        "1:                               \n\t"
+        "pop  r31                         \n\t"  /* 2  restore registers */
+        "pop  r30                         \n\t"  /* 2 */
+        "pop  r24                         \n\t"  /* 2 */
+        "out  __SREG__, r24               \n\t"  /* 1 */
+        "pop  r24                         \n\t"  /* 2 */
+        "reti                             \n\t"  /* 4 */
+        "2:                               \n\t"
+        "lds  r24, %[control]             \n\t"  /* tx buffer empty, disable UDRE interrupt */
+        "andi r24, %[udrie]               \n\t"
+        "sts  %[control], r24             \n\t"
+        "rjmp 1b                          \n\t"
+        :
+        : [data]    "n" (_SFR_MEM_ADDR(UART0_DATA)),
+          [control] "n" (_SFR_MEM_ADDR(UART0_CONTROL)),
+          [udrie]   "M" ((unsigned char)~_BV(UART0_UDRIE)),
+          [mask]    "M" (UART0_TX_BUFFER_MASK),
+          [head]    "i" (&uart_state[0].tx_head),
+          [tail]    "i" (&uart_state[0].tx_tail),
+          [buf]     "i" (UART_TxBuf)
+    );
+}
+
+#else /* if UART_ASM_ISR */
+
+ISR(UART0_RECEIVE_INTERRUPT)
+
+/*************************************************************************
+ * Function: UART Receive Complete interrupt
+ * Purpose:  called when the UART has received a character
+ **************************************************************************/
+{
+    uart_port_rx_isr(0);
+}
+
+
+ISR(UART0_TRANSMIT_INTERRUPT)
+
+/*************************************************************************
+ * Function: UART Data Register Empty interrupt
+ * Purpose:  called when the UART is ready to transmit the next byte
+ **************************************************************************/
+{
+    uart_port_tx_isr(0);
+}
+
+#endif /* if UART_ASM_ISR */
+
+#if UART_RX_IDLE
+ISR(TIMER2_COMPA_vect)
+
+/*************************************************************************
+ * Function: Timer/Counter2 compare match interrupt
+ * Purpose:  no byte received for UART_RX_IDLE_BITS, end current frame
+ **************************************************************************/
+{
+    unsigned char tmphead;
+
+
+    /* stop timer until the next byte is received */
+    TCCR2B = 0;
+
+    if (UART_RxFrameLen == 0)
+    {
+        return;
+    }
+
+    tmphead = (UART_RxFrameHead + 1) & UART_RX_FRAMES_MASK;
+    if (tmphead == UART_RxFrameTail)
+    {
+        /* frame queue full, frame is merged with the next one */
+        uart_state[0].last_rx_error |= UART_BUFFER_OVERFLOW >> 8;
+        return;
+    }
+
+    UART_RxFrameQ[tmphead] = UART_RxFrameLen;
+    UART_RxFrameHead       = tmphead;
+    UART_RxFrameLen        = 0;
+}
+#endif /* if UART_RX_IDLE */
+
+#if UART_FLOW_CONTROL
+ISR(UART_CTS_PCINT_vect)
+
+/*************************************************************************
+ * Function: CTS pin change interrupt
+ * Purpose:  resume transmission when the peer asserts CTS,
+ *           UDRE interrupt disables itself again if buffer is empty
+ **************************************************************************/
+{
+    if (!UART_CTS_BLOCKED())
+        UART0_CONTROL |= _BV(UART0_UDRIE);
+}
+#endif /* if UART_FLOW_CONTROL */
+
+
+/*************************************************************************
+ * Function: uart_init()
+ * Purpose:  initialize UART and set baudrate
+ * Input:    baudrate using macro UART_BAUD_SELECT()
+ * Returns:  none
+ **************************************************************************/
+void uart_init(unsigned int baudrate)
+{
+    uart_port_init(0, baudrate);
 }/* uart_init */
 
 /*************************************************************************
- * Function: uart1_getc()
+ * Function: uart_getc()
  * Purpose:  return byte from ringbuffer
  * Returns:  lower byte:  received byte from ringbuffer
  *        higher byte: last receive error
  **************************************************************************/
-unsigned int uart1_getc(void)
+unsigned int uart_getc(void)
+{
+    return uart_port_getc(0);
+}/* uart_getc */
+
+/*************************************************************************
+ * Function: uart_tx_stage()
+ * Purpose:  store byte behind the head of ringbuffer without sending it
+ * Input:    position behind the head and byte to be stored
+ * Returns:  1 if stored, 0 if position is not free
+ **************************************************************************/
+unsigned char uart_tx_stage(uint16_t offset, unsigned char data)
+{
+    return uart_port_tx_stage(0, offset, data);
+}/* uart_tx_stage */
+
+/*************************************************************************
+ * Function: uart_tx_commit()
+ * Purpose:  publish staged bytes for transmitting
+ * Input:    number of staged bytes
+ * Returns:  none
+ **************************************************************************/
+void uart_tx_commit(uint16_t len)
+{
+    uart_port_tx_commit(0, len);
+}/* uart_tx_commit */
+
+#if UART_STATS
+/*************************************************************************
+ * Function: uart_stats_get()
+ * Purpose:  copy health counters of UART
+ * Input:    structure to be filled in
+ * Returns:  none
+ **************************************************************************/
+void uart_stats_get(uart_stats_t *stats)
+{
+    uart_port_stats_get(0, stats);
+}/* uart_stats_get */
+
+/*************************************************************************
+ * Function: uart_stats_clear()
+ * Purpose:  clear health counters of UART
+ * Returns:  none
+ **************************************************************************/
+void uart_stats_clear(void)
+{
+    uart_port_stats_clear(0);
+}/* uart_stats_clear */
+#endif /* if UART_STATS */
+
+#if UART_RX_LINE_MODE
+/*************************************************************************
+ * Function: uart_peek_line()
+ * Purpose:  return oldest complete line in place inside receive buffer
+ * Input:    pointers to store line start and length
+ * Returns:  number of complete lines available
+ **************************************************************************/
+unsigned char uart_peek_line(const char **p, uint8_t *len)
 {
     unsigned char tmptail;
-    unsigned int data;
-    unsigned char lastRxError;
+    unsigned char lines;
 
 
-    if (UART1_RxHead == UART1_RxTail)
+    tmptail = UART_RxLineTail;
+    lines   = (UART_RxLineHead - tmptail) & UART_RX_LINES_MASK;
+    if (lines == 0)
     {
-        return UART_NO_DATA; /* no data available */
+        return 0; /* no complete line available */
     }
 
-    /* calculate buffer index */
-    tmptail = (UART1_RxTail + 1) & UART_RX_BUFFER_MASK;
+    /* the line is not touched by the ISR until it is consumed */
+    tmptail = (tmptail + 1) & UART_RX_LINES_MASK;
+    *p      = (const char *)&UART_RxBuf[(uart_state[0].rx_tail + 1) & UART0_RX_BUFFER_MASK];
+    *len    = UART_RxLineQ[tmptail];
 
-    /* get data from receive buffer */
-    data        = UART1_RxBuf[tmptail];
-    lastRxError = UART1_LastRxError;
+    return lines;
+}/* uart_peek_line */
 
-    /* store buffer index */
-    UART1_RxTail = tmptail;
+/*************************************************************************
+ * Function: uart_consume()
+ * Purpose:  release bytes of the oldest complete line
+ * Input:    number of bytes to release
+ * Returns:  none
+ **************************************************************************/
+void uart_consume(uint8_t len)
+{
+    unsigned char tmptail;
 
-    UART1_LastRxError = 0;
-    return (lastRxError << 8) + data;
-}/* uart1_getc */
 
+    if (UART_RxLineHead == UART_RxLineTail)
+    {
+        return; /* no complete line available */
+    }
+
+    tmptail = (UART_RxLineTail + 1) & UART_RX_LINES_MASK;
+    if (len >= UART_RxLineQ[tmptail])
+    {
+        /* whole line released */
+        len             = UART_RxLineQ[tmptail];
+        UART_RxLineTail = tmptail;
+    }
+    else
+    {
+        UART_RxLineQ[tmptail] -= len;
+    }
+
+    uart_index_store(&uart_state[0].rx_tail,
+                     (uart_state[0].rx_tail + len) & UART0_RX_BUFFER_MASK);
+    uart_port_rts_update(0);
+}/* uart_consume */
+#endif /* if UART_RX_LINE_MODE */
+
+#if UART_RX_IDLE
 /*************************************************************************
- * Function: uart1_putc()
+ * Function: uart_rx_frame()
+ * Purpose:  return length of oldest frame ended by an idle gap
+ * Returns:  number of bytes, 0 if no frame is complete
+ **************************************************************************/
+uint16_t uart_rx_frame(void)
+{
+    unsigned char tmptail;
+    uint16_t len;
+
+
+    if (UART_RxFrameHead == UART_RxFrameTail)
+    {
+        return 0; /* no complete frame available */
+    }
+
+    tmptail          = (UART_RxFrameTail + 1) & UART_RX_FRAMES_MASK;
+    len              = UART_RxFrameQ[tmptail];
+    UART_RxFrameTail = tmptail;
+
+    return len;
+}/* uart_rx_frame */
+#endif /* if UART_RX_IDLE */
+
+/*************************************************************************
+ * Function: uart_putc()
  * Purpose:  write byte to ringbuffer for transmitting via UART
  * Input:    byte to be transmitted
  * Returns:  none
  **************************************************************************/
-void uart1_putc(unsigned char data)
+void uart_putc(unsigned char data)
 {
-    unsigned char tmphead;
+    uart_port_putc(0, data);
+}/* uart_putc */
+
+/*************************************************************************
+ * Function: uart_try_putc()
+ * Purpose:  write byte to ringbuffer only if there is free space
+ * Input:    byte to be transmitted
+ * Returns:  1 if queued, 0 if buffer is full
+ **************************************************************************/
+unsigned char uart_try_putc(unsigned char data)
+{
+    return uart_port_try_putc(0, data);
+}/* uart_try_putc */
+
+/*************************************************************************
+ * Function: uart_tx_free()
+ * Purpose:  return number of free bytes in transmit ringbuffer
+ * Returns:  number of bytes
+ **************************************************************************/
+uint16_t uart_tx_free(void)
+{
+    return uart_port_tx_free(0);
+}/* uart_tx_free */
+
+/*************************************************************************
+ * Function: uart_puts()
+ * Purpose:  transmit string to UART
+ * Input:    string to be transmitted
+ * Returns:  none
+ **************************************************************************/
+void uart_puts(const char *s)
+{
+    uart_port_puts(0, s, 0);
+}/* uart_puts */
+
+/*************************************************************************
+ * Function: uart_puts_p()
+ * Purpose:  transmit string from program memory to UART
+ * Input:    program memory string to be transmitted
+ * Returns:  none
+ **************************************************************************/
+void uart_puts_p(const char *progmem_s)
+{
+    uart_port_puts(0, progmem_s, 1);
+}/* uart_puts_p */
+
+/*************************************************************************
+ * Function: uart_write()
+ * Purpose:  copy block of bytes to ringbuffer in one pass
+ * Input:    buffer and number of bytes to be transmitted
+ * Returns:  number of bytes queued
+ **************************************************************************/
+uint16_t uart_write(const void *buf, uint16_t len)
+{
+    return uart_port_write(0, buf, len, 0);
+}/* uart_write */
+
+/*************************************************************************
+ * Function: uart_write_P()
+ * Purpose:  copy block of bytes from program memory to ringbuffer
+ * Input:    program memory buffer and number of bytes to be transmitted
+ * Returns:  number of bytes queued
+ **************************************************************************/
+uint16_t uart_write_P(const void *buf, uint16_t len)
+{
+    return uart_port_write(0, buf, len, 1);
+}/* uart_write_P */
+
+/*************************************************************************
+ * Function: uart_fmt_putc()
+ * Purpose:  stage one character of formatted output, publish full chunks
+ * Input:    number of staged bytes, character
+ * Returns:  none
+ **************************************************************************/
+static void uart_fmt_putc(uint16_t *len, char c)
+{
+    if (uart_port_tx_stage(0, *len, c))
+    {
+        (*len)++;
+        return;
+    }
+
+    /* buffer full or chunk longer than buffer: publish and start again */
+    uart_port_tx_commit(0, *len);
+    *len = 0;
+    if (uart_port_tx_stage(0, 0, c))
+        *len = 1;
+    else
+        uart_port_putc(0, c); /* handled according to UART_TX_POLICY */
+}/* uart_fmt_putc */
 
+/*************************************************************************
+ * Function: uart_fmt_num()
+ * Purpose:  stage number in decimal or hexadecimal format
+ * Input:    number of staged bytes, absolute value, base 10 or 16,
+ *           sign, minimum width and pad character
+ * Returns:  none
+ **************************************************************************/
+static void uart_fmt_num(uint16_t *len, uint32_t val, uint8_t base,
+                         uint8_t neg, uint8_t width, char pad)
+{
+    char buf[10];
+    uint8_t i = sizeof(buf);
+    uint8_t digit;
 
-    tmphead = (UART1_TxHead + 1) & UART_TX_BUFFER_MASK;
 
-    while (tmphead == UART1_TxTail)
+    /* digits from the least significant one, no division for 16-bit values */
+    do
     {
-        ;/* wait for free space in buffer */
+        if (base == 16)
+        {
+            digit = val & 0x0F;
+            val >>= 4;
+        }
+        else if (val <= 0xFFFF)
+        {
+            uint16_t q = ((uint32_t)(uint16_t)val * 0xCCCDu) >> 19; /* val / 10 */
+            digit = (uint16_t)val - q * 10;
+            val = q;
+        }
+        else
+        {
+            uint32_t q = val / 10;
+            digit = val - q * 10;
+            val = q;
+        }
+        buf[--i] = (digit < 10) ? '0' + digit : 'a' - 10 + digit;
+    } while (val);
+
+    digit = sizeof(buf) - i + neg; /* printed width */
+    if (neg && pad == '0')
+        uart_fmt_putc(len, '-');
+    for (; width > digit; width--)
+        uart_fmt_putc(len, pad);
+    if (neg && pad != '0')
+        uart_fmt_putc(len, '-');
+    while (i < sizeof(buf))
+        uart_fmt_putc(len, buf[i++]);
+}/* uart_fmt_num */
+
+/*************************************************************************
+ * Function: uart_printf_P()
+ * Purpose:  format directly into the transmit ringbuffer
+ * Input:    program memory format string and arguments
+ * Returns:  none
+ **************************************************************************/
+void uart_printf_P(const char *fmt, ...)
+{
+    va_list ap;
+    uint16_t len = 0;
+    char c;
+
+
+    va_start(ap, fmt);
+    while ((c = pgm_read_byte(fmt++)) != '\0')
+    {
+        uint8_t width = 0;
+        uint8_t is_long = 0;
+        char pad = ' ';
+        int32_t sval;
+        uint32_t val;
+        const char *s;
+
+        if (c != '%')
+        {
+            uart_fmt_putc(&len, c);
+            continue;
+        }
+
+        /* optional zero flag, width and long modifier */
+        c = pgm_read_byte(fmt++);
+        if (c == '0')
+        {
+            pad = '0';
+            c = pgm_read_byte(fmt++);
+        }
+        while (c >= '0' && c <= '9')
+        {
+            width = width * 10 + (c - '0');
+            c = pgm_read_byte(fmt++);
+        }
+        if (c == 'l')
+        {
+            is_long = 1;
+            c = pgm_read_byte(fmt++);
+        }
+
+        switch (c)
+        {
+        case 'd':
+            sval = is_long ? va_arg(ap, long) : va_arg(ap, int);
+            uart_fmt_num(&len, (sval < 0) ? -(uint32_t)sval : (uint32_t)sval,
+                         10, sval < 0, width, pad);
+            break;
+        case 'u':
+        case 'x':
+            val = is_long ? va_arg(ap, unsigned long) : va_arg(ap, unsigned int);
+            uart_fmt_num(&len, val, (c == 'x') ? 16 : 10, 0, width, pad);
+            break;
+        case 'q':
+            /* integer and decimal part, e.g. bytes of DHT12; bit 7 of
+               the decimal part is the sign, so that values between -1
+               and 0 keep their minus sign */
+            sval = va_arg(ap, int);
+            val  = va_arg(ap, unsigned int);
+            uart_fmt_num(&len, (sval < 0) ? -(uint32_t)sval : (uint32_t)sval,
+                         10, (sval < 0) || (val & 0x80), width, pad);
+            uart_fmt_putc(&len, '.');
+            uart_fmt_num(&len, val & 0x7f, 10, 0, 0, ' ');
+            break;
+        case 's':
+            s = va_arg(ap, const char *);
+            while (*s)
+                uart_fmt_putc(&len, *s++);
+            break;
+        case 'S':
+            s = va_arg(ap, const char *);
+            while ((c = pgm_read_byte(s++)) != '\0')
+                uart_fmt_putc(&len, c);
+            break;
+        case 'c':
+            uart_fmt_putc(&len, (char)va_arg(ap, int));
+            break;
+        case '\0':
+            fmt--; /* lone '%' at the end of format string */
+            break;
+        default:
+            uart_fmt_putc(&len, c); /* "%%" and unknown conversions */
+            break;
+        }
     }
+    va_end(ap);
 
-    UART1_TxBuf[tmphead] = data;
-    UART1_TxHead         = tmphead;
+    uart_port_tx_commit(0, len);
+}/* uart_printf_P */
 
-    /* enable UDRE interrupt */
-    UART1_CONTROL |= _BV(UART1_UDRIE);
+/*
+ * these functions are only for ATmegas with two USART
+ */
+#if defined( ATMEGA_USART1 )
+
+ISR(UART1_RECEIVE_INTERRUPT)
+
+/*************************************************************************
+ * Function: UART1 Receive Complete interrupt
+ * Purpose:  called when the UART1 has received a character
+ **************************************************************************/
+{
+    uart_port_rx_isr(1);
+}
+
+
+ISR(UART1_TRANSMIT_INTERRUPT)
+
+/*************************************************************************
+ * Function: UART1 Data Register Empty interrupt
+ * Purpose:  called when the UART1 is ready to transmit the next byte
+ **************************************************************************/
+{
+    uart_port_tx_isr(1);
+}
+
+
+/*************************************************************************
+ * Function: uart1_init()
+ * Purpose:  initialize UART1 and set baudrate
+ * Input:    baudrate using macro UART_BAUD_SELECT()
+ * Returns:  none
+ **************************************************************************/
+void uart1_init(unsigned int baudrate)
+{
+    uart_port_init(1, baudrate);
+}/* uart1_init */
+
+/*************************************************************************
+ * Function: uart1_getc()
+ * Purpose:  return byte from ringbuffer
+ * Returns:  lower byte:  received byte from ringbuffer
+ *        higher byte: last receive error
+ **************************************************************************/
+unsigned int uart1_getc(void)
+{
+    return uart_port_getc(1);
+}/* uart1_getc */
+
+/*************************************************************************
+ * Function: uart1_putc()
+ * Purpose:  write byte to ringbuffer for transmitting via UART
+ * Input:    byte to be transmitted
+ * Returns:  none
+ **************************************************************************/
+void uart1_putc(unsigned char data)
+{
+    uart_port_putc(1, data);
 }/* uart1_putc */
 
+/*************************************************************************
+ * Function: uart1_try_putc()
+ * Purpose:  write byte to ringbuffer only if there is free space
+ * Input:    byte to be transmitted
+ * Returns:  1 if queued, 0 if buffer is full
+ **************************************************************************/
+unsigned char uart1_try_putc(unsigned char data)
+{
+    return uart_port_try_putc(1, data);
+}/* uart1_try_putc */
+
+/*************************************************************************
+ * Function: uart1_tx_free()
+ * Purpose:  return number of free bytes in transmit ringbuffer
+ * Returns:  number of bytes
+ **************************************************************************/
+uint16_t uart1_tx_free(void)
+{
+    return uart_port_tx_free(1);
+}/* uart1_tx_free */
+
 /*************************************************************************
  * Function: uart1_puts()
  * Purpose:  transmit string to UART1
@@ -754,8 +1871,7 @@ void uart1_putc(unsigned char data)
  **************************************************************************/
 void uart1_puts(const char *s)
 {
-    while (*s)
-        uart1_putc(*s++);
+    uart_port_puts(1, s, 0);
 }/* uart1_puts */
 
 /*************************************************************************
@@ -766,10 +1882,52 @@ void uart1_puts(const char *s)
  **************************************************************************/
 void uart1_puts_p(const char *progmem_s)
 {
-    register char c;
-
-    while ( (c = pgm_read_byte(progmem_s++)) )
-        uart1_putc(c);
+    uart_port_puts(1, progmem_s, 1);
 }/* uart1_puts_p */
 
+/*************************************************************************
+ * Function: uart1_write()
+ * Purpose:  copy block of bytes to ringbuffer of UART1 in one pass
+ * Input:    buffer and number of bytes to be transmitted
+ * Returns:  number of bytes queued
+ **************************************************************************/
+uint16_t uart1_write(const void *buf, uint16_t len)
+{
+    return uart_port_write(1, buf, len, 0);
+}/* uart1_write */
+
+/*************************************************************************
+ * Function: uart1_write_P()
+ * Purpose:  copy block of bytes from program memory to ringbuffer of UART1
+ * Input:    program memory buffer and number of bytes to be transmitted
+ * Returns:  number of bytes queued
+ **************************************************************************/
+uint16_t uart1_write_P(const void *buf, uint16_t len)
+{
+    return uart_port_write(1, buf, len, 1);
+}/* uart1_write_P */
+
+#if UART_STATS
+/*************************************************************************
+ * Function: uart1_stats_get()
+ * Purpose:  copy health counters of UART1
+ * Input:    structure to be filled in
+ * Returns:  none
+ **************************************************************************/
+void uart1_stats_get(uart_stats_t *stats)
+{
+    uart_port_stats_get(1, stats);
+}/* uart1_stats_get */
+
+/*************************************************************************
+ * Function: uart1_stats_clear()
+ * Purpose:  clear health counters of UART1
+ * Returns:  none
+ **************************************************************************/
+void uart1_stats_clear(void)
+{
+    uart_port_stats_clear(1);
+}/* uart1_stats_clear */
+#endif /* if UART_STATS */
+
 #endif /* if defined( ATMEGA_USART1 ) */
@@ -93,9 +93,189 @@
 # define UART_TX_BUFFER_SIZE 64
 #endif
 
+/** @brief  Size of the circular receive buffer of USART0, must be power of 2
+ *
+ *  Every port has its own buffer sizes, by default UART_RX_BUFFER_SIZE and
+ *  UART_TX_BUFFER_SIZE. If any buffer is larger than 256 bytes, 16-bit
+ *  buffer indices are used and accessed atomically.
+ */
+#ifndef UART0_RX_BUFFER_SIZE
+# define UART0_RX_BUFFER_SIZE UART_RX_BUFFER_SIZE
+#endif
+
+/** @brief  Size of the circular transmit buffer of USART0, must be power of 2 */
+#ifndef UART0_TX_BUFFER_SIZE
+# define UART0_TX_BUFFER_SIZE UART_TX_BUFFER_SIZE
+#endif
+
+/** @brief  Size of the circular receive buffer of USART1, must be power of 2 */
+#ifndef UART1_RX_BUFFER_SIZE
+# define UART1_RX_BUFFER_SIZE UART_RX_BUFFER_SIZE
+#endif
+
+/** @brief  Size of the circular transmit buffer of USART1, must be power of 2 */
+#ifndef UART1_TX_BUFFER_SIZE
+# define UART1_TX_BUFFER_SIZE UART_TX_BUFFER_SIZE
+#endif
+
+/** @brief  Use hand-optimized assembly receive and UDRE interrupt handlers
+ *
+ *  The naked handlers save only the registers they use and work on the same
+ *  buffers as the C version. Cycle counts incl. interrupt response, vector
+ *  jump and reti on ATmega328P are 55 for receive and 46 for transmit, against one
+ *  character time of 160 cycles at 1 Mbaud and 80 cycles at 2 Mbaud
+ *  (16 MHz, U2X, see UART_BAUD_SELECT_DOUBLE_SPEED()). Both directions can
+ *  be streamed at 1 Mbaud, one direction at 2 Mbaud.
+ *  Only for USART0 with buffers of at most 256 bytes, can not be combined
+ *  with UART_RX_LINE_MODE.
+ *  Add CDEFS += -DUART_ASM_ISR=1 to your Makefile.
+ */
+#ifndef UART_ASM_ISR
+# define UART_ASM_ISR 0
+#endif
+
+/** @brief  Collect health counters and buffer high-water marks, see uart_stats_get()
+ *
+ *  Add CDEFS += -DUART_STATS=1 to your Makefile. Can not be combined with UART_ASM_ISR.
+ */
+#ifndef UART_STATS
+# define UART_STATS 0
+#endif
+
+/** @brief  Free-running counter used to measure time spent in the UART ISRs
+ *
+ *  Optional, e.g. CDEFS += -DUART_STATS_TIMER=TCNT1 with Timer/Counter1
+ *  running at prescaler 1 gives CPU cycles. Register save/restore of
+ *  the ISR is not included. Ignored unless UART_STATS is enabled.
+ */
+#ifdef DOXYGEN
+# define UART_STATS_TIMER TCNT1
+#endif
+
+/** @brief  Enable RTS/CTS flow control of USART0 on GPIO pins
+ *
+ *  RTS output is driven high when the receive buffer holds
+ *  UART_RTS_HIGH_WATER bytes and low again when it drops to
+ *  UART_RTS_LOW_WATER bytes. The transmit interrupt pauses while the CTS
+ *  input is high and a pin change interrupt on CTS resumes it. One or two
+ *  bytes already in the USART are still sent after CTS goes high.
+ *  The CTS pin change vector is used by the library and the internal
+ *  pull-up is enabled, so an unconnected CTS blocks the transmitter.
+ *  Can not be combined with UART_ASM_ISR.
+ *  Add CDEFS += -DUART_FLOW_CONTROL=1 to your Makefile.
+ */
+#ifndef UART_FLOW_CONTROL
+# define UART_FLOW_CONTROL 0
+#endif
+
+#ifndef UART_RTS_PORT
+# define UART_RTS_PORT PORTD        /**< @brief Port of RTS output */
+#endif
+#ifndef UART_RTS_PIN
+# define UART_RTS_PIN 4             /**< @brief RTS pin, active low */
+#endif
+#ifndef UART_CTS_PORT
+# define UART_CTS_PORT PORTD        /**< @brief Port of CTS input */
+#endif
+#ifndef UART_CTS_PIN
+# define UART_CTS_PIN 5             /**< @brief CTS pin, active low */
+#endif
+#ifndef UART_CTS_PCINT_vect
+# define UART_CTS_PCINT_vect PCINT2_vect  /**< @brief Pin change vector of CTS pin */
+#endif
+#ifndef UART_CTS_PCMSK
+# define UART_CTS_PCMSK PCMSK2      /**< @brief Pin change mask register of CTS pin */
+#endif
+#ifndef UART_CTS_PCIE
+# define UART_CTS_PCIE PCIE2        /**< @brief Pin change interrupt enable bit of CTS pin */
+#endif
+#ifndef UART_CTS_PCINT
+# define UART_CTS_PCINT UART_CTS_PIN  /**< @brief Bit of CTS pin in UART_CTS_PCMSK */
+#endif
+#ifndef UART_RTS_HIGH_WATER
+# define UART_RTS_HIGH_WATER (UART0_RX_BUFFER_SIZE * 3 / 4)  /**< @brief RTS goes high at this buffer occupancy */
+#endif
+#ifndef UART_RTS_LOW_WATER
+# define UART_RTS_LOW_WATER (UART0_RX_BUFFER_SIZE / 4)       /**< @brief RTS goes low at this buffer occupancy */
+#endif
+
+/** @brief  TX policy: uart_putc() waits for free space in the buffer */
+#define UART_TX_BLOCK     0
+/** @brief  TX policy: uart_putc() discards the new byte if the buffer is full */
+#define UART_TX_DROP      1
+/** @brief  TX policy: uart_putc() discards the oldest unsent byte if the buffer is full */
+#define UART_TX_OVERWRITE 2
+
+/** @brief  Behaviour of uart_putc(), uart_puts() and uart_puts_p() on a full transmit buffer
+ *
+ *  UART_TX_DROP and UART_TX_OVERWRITE never wait, so the functions can be
+ *  called from interrupt service routines with bounded cost per byte.
+ *  Add CDEFS += -DUART_TX_POLICY=UART_TX_DROP to your Makefile to change it.
+ */
+#ifndef UART_TX_POLICY
+# define UART_TX_POLICY UART_TX_BLOCK
+#endif
+
+/** @brief  Enable line receive mode, see uart_peek_line()
+ *
+ *  The receive interrupt looks for UART_RX_DELIMITER and records the length
+ *  of every complete line, so the application can parse it in place inside
+ *  the receive buffer. Add CDEFS += -DUART_RX_LINE_MODE=1 to your Makefile.
+ */
+#ifndef UART_RX_LINE_MODE
+# define UART_RX_LINE_MODE 0
+#endif
+
+/** @brief  Byte which terminates a line in line receive mode */
+#ifndef UART_RX_DELIMITER
+# define UART_RX_DELIMITER '\n'
+#endif
+
+/** @brief  Maximum line length in line receive mode, longer lines are split
+ *
+ *  The first UART_RX_LINE_MAX bytes of the receive buffer are mirrored
+ *  behind its end, so a line wrapping around the buffer stays contiguous.
+ */
+#ifndef UART_RX_LINE_MAX
+# if ( UART0_RX_BUFFER_SIZE > 256 )
+#  define UART_RX_LINE_MAX 255
+# else
+#  define UART_RX_LINE_MAX (UART0_RX_BUFFER_SIZE / 2)
+# endif
+#endif
+
+/** @brief  Number of complete lines which can be queued, must be power of 2 */
+#ifndef UART_RX_LINES
+# define UART_RX_LINES 8
+#endif
+
+/** @brief  Enable idle-gap frame detection on USART0, see uart_rx_frame()
+ *
+ *  Every received byte restarts Timer/Counter2 in CTC mode. When no byte
+ *  arrives for UART_RX_IDLE_BITS bit times, the compare match interrupt
+ *  marks the end of a frame, as required by Modbus RTU or the SDS011
+ *  sensor. Timer/Counter2 and its compare A interrupt are used by the
+ *  library; the longest gap is 255*1024 CPU cycles.
+ *  Can not be combined with UART_ASM_ISR.
+ *  Add CDEFS += -DUART_RX_IDLE=1 to your Makefile.
+ */
+#ifndef UART_RX_IDLE
+# define UART_RX_IDLE 0
+#endif
+
+/** @brief  Silence which ends a frame, in bit times (35 = 3.5 characters) */
+#ifndef UART_RX_IDLE_BITS
+# define UART_RX_IDLE_BITS 35
+#endif
+
+/** @brief  Number of complete frames which can be queued, must be power of 2 */
+#ifndef UART_RX_FRAMES
+# define UART_RX_FRAMES 4
+#endif
+
 /* test if the size of the circular buffers fits into SRAM */
-#if ( (UART_RX_BUFFER_SIZE + UART_TX_BUFFER_SIZE) >= (RAMEND - 0x60 ) )
-# error "size of UART_RX_BUFFER_SIZE + UART_TX_BUFFER_SIZE larger than size of SRAM"
+#if ( (UART0_RX_BUFFER_SIZE + UART0_TX_BUFFER_SIZE) >= (RAMEND - 0x60 ) )
+# error "size of UART0_RX_BUFFER_SIZE + UART0_TX_BUFFER_SIZE larger than size of SRAM"
 #endif
 
 /*
@@ -108,6 +288,23 @@
 #define UART_NO_DATA         0x0100 /**< @brief no receive data available   */
 
 
+/** @brief  Snapshot of UART health counters, see uart_stats_get() */
+typedef struct
+{
+    uint32_t rx_bytes;          /**< @brief bytes stored in the receive buffer */
+    uint32_t tx_bytes;          /**< @brief bytes written to the data register */
+    uint16_t frame_errors;      /**< @brief received bytes with FE flag */
+    uint16_t overrun_errors;    /**< @brief received bytes with DOR flag */
+    uint16_t parity_errors;     /**< @brief received bytes with UPE flag */
+    uint16_t rx_overflows;      /**< @brief bytes lost due to full receive buffer */
+    uint16_t tx_dropped;        /**< @brief bytes lost due to full transmit buffer, see UART_TX_POLICY */
+    uint16_t rx_peak;           /**< @brief maximum receive buffer occupancy in bytes */
+    uint16_t tx_peak;           /**< @brief maximum transmit buffer occupancy in bytes */
+    uint16_t rx_isr_ticks;      /**< @brief longest receive ISR in UART_STATS_TIMER ticks */
+    uint16_t tx_isr_ticks;      /**< @brief longest UDRE ISR in UART_STATS_TIMER ticks */
+} uart_stats_t;
+
+
 /*
 ** function prototypes
 */
@@ -149,18 +346,118 @@ extern unsigned int uart_getc(void);
 
 /**
  *  @brief   Put byte to ringbuffer for transmitting via UART
+ *
+ *  If the buffer is full, the byte is handled according to UART_TX_POLICY.
+ *
  *  @param   data byte to be transmitted
  *  @return  none
  */
 extern void uart_putc(unsigned char data);
 
 
+/**
+ *  @brief   Put byte to ringbuffer only if there is free space, never blocks
+ *  @param   data byte to be transmitted
+ *  @return  1 if the byte has been queued, 0 if the buffer is full
+ */
+extern unsigned char uart_try_putc(unsigned char data);
+
+
+/**
+ *  @brief   Get number of free bytes in the transmit ringbuffer
+ *  @return  number of bytes which can be queued without blocking
+ */
+extern uint16_t uart_tx_free(void);
+
+
+/**
+ *  @brief   Store byte behind the head of the transmit ringbuffer without sending it
+ *
+ *  Staged bytes are not transmitted and may be overwritten until they are
+ *  published by uart_tx_commit(). Used by encoders which have to patch
+ *  bytes already written, such as COBS.
+ *  Waits for free space only with UART_TX_BLOCK policy.
+ *
+ *  @param   offset position behind the head, 0 .. UART0_TX_BUFFER_SIZE-2
+ *  @param   data byte to be stored
+ *  @return  1 if stored, 0 if the position is not free
+ */
+extern unsigned char uart_tx_stage(uint16_t offset, unsigned char data);
+
+
+/**
+ *  @brief   Publish staged bytes for transmitting via UART
+ *  @param   len number of staged bytes, starting at offset 0
+ *  @return  none
+ */
+extern void uart_tx_commit(uint16_t len);
+
+
+/**
+ *  @brief   Copy health counters of the UART
+ *
+ *  Only available with UART_STATS. Counters are not cleared by reading,
+ *  use uart_stats_clear().
+ *
+ *  @param   stats structure to be filled in
+ *  @return  none
+ */
+extern void uart_stats_get(uart_stats_t *stats);
+
+
+/**
+ *  @brief   Clear health counters and high-water marks of the UART
+ *  @return  none
+ */
+extern void uart_stats_clear(void);
+
+
+/**
+ *  @brief   Get the oldest complete line from the receive buffer without copying
+ *
+ *  Only available with UART_RX_LINE_MODE, for USART0. The line stays in the receive
+ *  buffer, including its delimiter, until it is released by uart_consume().
+ *  Do not mix with uart_getc() in this mode.
+ *
+ *  @param   p   pointer to the first byte of the line
+ *  @param   len length of the line including the delimiter
+ *  @return  number of complete lines available, 0 if there is none
+ */
+extern unsigned char uart_peek_line(const char **p, uint8_t *len);
+
+
+/**
+ *  @brief   Release bytes of the line returned by uart_peek_line()
+ *
+ *  If len is smaller than the line length, the rest of the line is
+ *  returned by the next uart_peek_line() call.
+ *
+ *  @param   len number of bytes to release
+ *  @return  none
+ */
+extern void uart_consume(uint8_t len);
+
+
+/**
+ *  @brief   Get length of the oldest frame ended by an idle gap
+ *
+ *  Only available with UART_RX_IDLE. The frame is removed from the frame
+ *  queue and its bytes have to be read by uart_getc(). If the queue
+ *  is full, UART_BUFFER_OVERFLOW is reported and the frame is merged
+ *  with the next one.
+ *
+ *  @return  number of bytes of the frame, 0 if no frame is complete
+ */
+extern uint16_t uart_rx_frame(void);
+
+
 /**
  *  @brief   Put string to ringbuffer for transmitting via UART
  *
  *  The string is buffered by the uart library in a circular buffer
  *  and one character at a time is transmitted to the UART using interrupts.
- *  Blocks if it can not write the whole string into the circular buffer.
+ *  Blocks if it can not write the whole string into the circular buffer
+ *  (see UART_TX_POLICY).
  *
  *  @param   s string to be transmitted
  *  @return  none
@@ -173,7 +470,8 @@ extern void uart_puts(const char *s);
  *
  * The string is buffered by the uart library in a circular buffer
  * and one character at a time is transmitted to the UART using interrupts.
- * Blocks if it can not write the whole string into the circular buffer.
+ * Blocks if it can not write the whole string into the circular buffer
+ * (see UART_TX_POLICY).
  *
  * @param    s program memory string to be transmitted
  * @return   none
@@ -187,6 +485,55 @@ extern void uart_puts_p(const char *s);
 #define uart_puts_P(__s) uart_puts_p(PSTR(__s))
 
 
+/**
+ * @brief    Put block of bytes to ringbuffer for transmitting via UART
+ *
+ * Copies as many bytes as fit into the circular buffer in one pass,
+ * updates the buffer head once and enables the UDRE interrupt once.
+ * Does not block; the caller has to resend the remaining bytes.
+ *
+ * @param    buf data to be transmitted
+ * @param    len number of bytes in buf
+ * @return   number of bytes actually queued, 0 .. len
+ */
+extern uint16_t uart_write(const void *buf, uint16_t len);
+
+
+/**
+ * @brief    Put block of bytes from program memory to ringbuffer for transmitting via UART
+ * @param    buf program memory data to be transmitted
+ * @param    len number of bytes in buf
+ * @return   number of bytes actually queued, 0 .. len
+ * @see      uart_write
+ */
+extern uint16_t uart_write_P(const void *buf, uint16_t len);
+
+
+/**
+ * @brief    Format string directly into the transmit ringbuffer
+ *
+ * Compact replacement of sprintf() followed by uart_puts(). Characters are
+ * staged behind the buffer head and published once per call, or in chunks
+ * if the output does not fit into the buffer (see UART_TX_POLICY).
+ * Supported conversions, with optional '0' flag, width and 'l' modifier:
+ * - \b %%d, \b %%u, \b %%x  signed, unsigned and hexadecimal integer
+ * - \b %%q  fixed-point number from two int arguments, the integer and the
+ *   decimal part, e.g. 23 and 5 give "23.5"; width applies to the integer part.
+ *   The decimal part is 0 to 127, its bit 7 marks a negative value as in the
+ *   DHT12 temperature, e.g. 0 and 0x85 give "-0.5"
+ * - \b %%s, \b %%S  string in RAM, string in program memory
+ * - \b %%c, \b %%%%  character, percent sign
+ *
+ * Only the decimal conversion of 32-bit values above 65535 uses division.
+ * Not reentrant, do not call from interrupt and main code at the same time.
+ *
+ * @param    fmt program memory format string
+ * @return   none
+ * @code uart_printf_P(PSTR("Temp: %q C, ADC: %04x\r\n"), values[2], values[3], adc); @endcode
+ */
+extern void uart_printf_P(const char *fmt, ...);
+
+
 /** @brief  Initialize USART1 (only available on selected ATmegas) @see uart_init */
 extern void uart1_init(unsigned int baudrate);
 /** @brief  Get received byte of USART1 from ringbuffer. (only available on selected ATmega) @see uart_getc */
@@ -199,6 +546,18 @@ extern void uart1_puts(const char *s);
 extern void uart1_puts_p(const char *s);
 /** @brief  Macro to automatically put a string constant into program memory */
 #define uart1_puts_P(__s) uart1_puts_p(PSTR(__s))
+/** @brief  Put byte to ringbuffer of USART1 only if there is free space (only available on selected ATmega) @see uart_try_putc */
+extern unsigned char uart1_try_putc(unsigned char data);
+/** @brief  Get number of free bytes in the transmit ringbuffer of USART1 (only available on selected ATmega) @see uart_tx_free */
+extern uint16_t uart1_tx_free(void);
+/** @brief  Put block of bytes to ringbuffer for transmitting via USART1 (only available on selected ATmega) @see uart_write */
+extern uint16_t uart1_write(const void *buf, uint16_t len);
+/** @brief  Put block of bytes from program memory to ringbuffer for transmitting via USART1 (only available on selected ATmega) @see uart_write_P */
+extern uint16_t uart1_write_P(const void *buf, uint16_t len);
+/** @brief  Copy health counters of USART1 (only available on selected ATmega) @see uart_stats_get */
+extern void uart1_stats_get(uart_stats_t *stats);
+/** @brief  Clear health counters of USART1 (only available on selected ATmega) @see uart_stats_clear */
+extern void uart1_stats_clear(void);
 
 /**@}*/
 
@@ -0,0 +1,122 @@
+/*
+ * Converter of PBM images to bitmaps for oled_blitBitmap().
+ * (c) 2025 Tomas Fryza, MIT license
+ *
+ * Reads a plain (P1) or raw (P4) PBM image from standard input and
+ * prints a C array in the layout of the display RAM: (height+7)/8
+ * pages of width bytes, bit 0 of each byte is the top row of the page.
+ * Black pixels of the image are lit on the display, use -i to invert.
+ *
+ * Build and usage:
+ *    gcc -O2 -o oled_bitmap oled_bitmap.c
+ *    convert logo.png -monochrome logo.pbm
+ *    ./oled_bitmap logo < logo.pbm > logo.h
+ */
+
+// -- Includes ---------------------------------------------
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+
+// -- Defines ----------------------------------------------
+#define MAX_WIDTH 128
+#define MAX_HEIGHT 64
+
+
+// -- Function definitions ---------------------------------
+/*
+ * Function: pbm_number()
+ * Purpose:  Read decimal number from PBM header, skip comments.
+ * Returns:  Number or -1 on end of file
+ */
+static int pbm_number(void)
+{
+    int c;
+    int n = 0;
+
+    do {
+        c = getchar();
+        if (c == '#')
+            while (c != '\n' && c != EOF)
+                c = getchar();
+    } while (isspace(c));
+
+    if (!isdigit(c))
+        return -1;
+    while (isdigit(c)) {
+        n = n * 10 + (c - '0');
+        c = getchar();
+    }
+    return n;
+}
+
+
+int main(int argc, char *argv[])
+{
+    static uint8_t pixel[MAX_HEIGHT][MAX_WIDTH];
+    const char *name = "bitmap";
+    int invert = 0;
+    int width, height;
+    int format;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-i") == 0)
+            invert = 1;
+        else
+            name = argv[i];
+    }
+
+    if (getchar() != 'P' || ((format = getchar()) != '1' && format != '4')) {
+        fprintf(stderr, "Input is not a P1 or P4 PBM image\n");
+        return 1;
+    }
+    width = pbm_number();
+    height = pbm_number();
+    if (width < 1 || width > MAX_WIDTH || height < 1 || height > MAX_HEIGHT) {
+        fprintf(stderr, "Image must be from 1x1 to %dx%d pixels\n",
+                MAX_WIDTH, MAX_HEIGHT);
+        return 1;
+    }
+
+    // Pixels row by row, 1 is black
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int c;
+
+            if (format == '1') {
+                do
+                    c = getchar();
+                while (isspace(c));
+                c = (c == '1');
+            } else {
+                static int byte;
+                if (x % 8 == 0)
+                    byte = getchar();
+                c = (byte >> (7 - x % 8)) & 1;
+            }
+            pixel[y][x] = c ^ invert;
+        }
+    }
+    if (feof(stdin)) {
+        fprintf(stderr, "Image data is truncated\n");
+        return 1;
+    }
+
+    // Display layout, page by page
+    printf("// %dx%d pixels, use oled_blitBitmap(x, y, %s, %d, %d, mode)\n",
+           width, height, name, width, height);
+    printf("const uint8_t %s[] PROGMEM = {", name);
+    for (int page = 0; page < (height + 7) / 8; page++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t byte = 0;
+
+            for (int bit = 0; bit < 8 && page * 8 + bit < height; bit++)
+                byte |= pixel[page * 8 + bit][x] << bit;
+            printf("%s0x%02x,", (x % 16) ? " " : "\n    ", byte);
+        }
+    }
+    printf("\n};\n");
+    return 0;
+}
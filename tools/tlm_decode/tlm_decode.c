@@ -0,0 +1,104 @@
+/*
+ * Linux decoder of binary telemetry packets sent by the tlm library.
+ * (c) 2025 Tomas Fryza, MIT license
+ *
+ * Reads COBS-framed packets from standard input, checks their
+ * CRC-16/CCITT-FALSE and prints the payload of every valid packet
+ * as one line of hexadecimal bytes.
+ *
+ * Build and usage:
+ *    gcc -O2 -o tlm_decode tlm_decode.c
+ *    stty -F /dev/ttyUSB0 115200 raw -echo
+ *    ./tlm_decode < /dev/ttyUSB0
+ */
+
+// -- Includes ---------------------------------------------
+#include <stdio.h>
+#include <stdint.h>
+
+
+// -- Defines ----------------------------------------------
+#define MAX_PACKET 1024
+
+
+// -- Function definitions ---------------------------------
+/*
+ * Function: crc16_ccitt()
+ * Purpose:  CRC-16/CCITT-FALSE, poly 0x1021, init 0xffff.
+ */
+static uint16_t crc16_ccitt(const uint8_t *buf, size_t len)
+{
+    uint16_t crc = 0xffff;
+
+    while (len--) {
+        crc ^= (uint16_t)*buf++ << 8;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+
+/*
+ * Function: cobs_decode()
+ * Purpose:  Decode one COBS frame without its 0x00 delimiter.
+ * Returns:  Decoded length or -1 on malformed frame
+ */
+static long cobs_decode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t i = 0;
+    size_t o = 0;
+
+    while (i < len) {
+        uint8_t code = in[i++];
+
+        if (code == 0 || i + code - 1 > len)
+            return -1;
+        for (uint8_t k = 1; k < code; k++)
+            out[o++] = in[i++];
+        if (code != 0xff && i < len)
+            out[o++] = 0;
+    }
+    return (long)o;
+}
+
+
+/*
+ * Function: main()
+ * Purpose:  Split input into frames and print valid packets.
+ */
+int main(void)
+{
+    static uint8_t frame[MAX_PACKET];
+    static uint8_t packet[MAX_PACKET];
+    size_t len = 0;
+    unsigned long good = 0;
+    unsigned long bad = 0;
+    int c;
+
+    while ((c = getchar()) != EOF) {
+        if (c != 0) {
+            if (len < MAX_PACKET)
+                frame[len++] = (uint8_t)c;
+            continue;
+        }
+
+        // Delimiter found, decode the frame
+        long n = cobs_decode(frame, len, packet);
+        len = 0;
+        if (n < 2 || crc16_ccitt(packet, n - 2) !=
+                     (packet[n - 2] | (packet[n - 1] << 8))) {
+            bad++;
+            continue;
+        }
+
+        good++;
+        for (long i = 0; i < n - 2; i++)
+            printf("%02x%s", packet[i], (i < n - 3) ? " " : "");
+        printf("\n");
+        fflush(stdout);
+    }
+
+    fprintf(stderr, "%lu packets, %lu dropped\n", good, bad);
+    return 0;
+}